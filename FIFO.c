@@ -31,47 +31,143 @@ jsDataType volatile *JsPutPt; // put next
 jsDataType volatile *JsGetPt; // get next
 jsDataType static JsFifo[JSFIFOSIZE];
 Sema4Type JsFifoAvailable;
+ChannelType JsFifoChannel;    // policy and statistics, rejects when full
 
 // initialize pointer FIFO
 void JsFifo_Init(void){ long sr;
   sr = StartCritical();      // make atomic
 	OS_InitSemaphore(&JsFifoAvailable, 0);
+  OS_ChannelInit(&JsFifoChannel, "JsFifo", JSFIFOSIZE-1, OS_CHANNEL_REJECT, 0);
   JsPutPt = JsGetPt = &JsFifo[0]; // Empty
   EndCritical(sr);
 }
 // add element to end of pointer FIFO
 // return RXFIFOSUCCESS if successful
-int JsFifo_Put(jsDataType data){
-  jsDataType volatile *nextPutPt;
-  nextPutPt = JsPutPt+1;
-  if(nextPutPt == &JsFifo[JSFIFOSIZE]){
-    nextPutPt = &JsFifo[0];  // wrap
+int JsFifo_Put(jsDataType data){ long sr;
+  int room;
+  while((room = OS_ChannelReserve(&JsFifoChannel)) == OS_CHANNEL_REPLACE){
+    if(JsFifo_Discard() == JSFIFOFAIL){
+      room = OS_CHANNEL_FULL;  // drop the new element instead
+      break;
+    }
   }
-  if(nextPutPt == JsGetPt){
+  if(room == OS_CHANNEL_FULL){
     return(JSFIFOFAIL);      // Failed, fifo full
   }
-  else{
-    *(JsPutPt) = data;       // Put
-    JsPutPt = nextPutPt;     // Success, update
-		OS_Signal(&JsFifoAvailable);
-    return(JSFIFOSUCCESS);
+  sr = StartCritical();
+  *(JsPutPt) = data;         // Put, JsFifoChannel reserved the room
+  JsPutPt = JsPutPt+1;
+  if(JsPutPt == &JsFifo[JSFIFOSIZE]){
+    JsPutPt = &JsFifo[0];    // wrap
   }
+  OS_ChannelPut(&JsFifoChannel, JsFifo_Size());
+  EndCritical(sr);
+  OS_Signal(&JsFifoAvailable);
+  return(JSFIFOSUCCESS);
+}
+// remove the oldest element unread, for OS_CHANNEL_DROPOLD
+// return JSFIFOFAIL if the consumer already claimed every element
+int JsFifo_Discard(void){ long sr;
+  if(OS_WaitTimeout(&JsFifoAvailable, 0) == 0){
+    return(JSFIFOFAIL);
+  }
+  sr = StartCritical();
+  JsGetPt++;
+  if(JsGetPt == &JsFifo[JSFIFOSIZE]){
+     JsGetPt = &JsFifo[0];   // wrap
+  }
+  EndCritical(sr);
+  OS_Signal(&JsFifoChannel.Room);
+  return(JSFIFOSUCCESS);
 }
 // remove element from front of pointer FIFO
 // return RXFIFOSUCCESS if successful
 int JsFifo_Get(jsDataType *datapt){
-  OS_Wait(&JsFifoAvailable);
+  return JsFifo_GetTimeout(datapt, OS_FOREVER);
+}
+// remove element from front of pointer FIFO, waiting at most timeout ms
+// return JSFIFOSUCCESS if successful, JSFIFOFAIL if nothing arrived in time
+int JsFifo_GetTimeout(jsDataType *datapt, unsigned long timeout){
+  if(OS_WaitTimeout(&JsFifoAvailable, timeout) == 0){
+    return(JSFIFOFAIL);      // Failed, producer is late
+  }
+  return JsFifo_Take(datapt);
+}
+// remove element from front of pointer FIFO without waiting,
+// after OS_WaitAny has taken JsFifoAvailable
+// return JSFIFOSUCCESS
+int JsFifo_Take(jsDataType *datapt){ long sr;
+  sr = StartCritical();      // a drop-oldest put may move JsGetPt too
   *datapt = *(JsGetPt++);
   if(JsGetPt == &JsFifo[JSFIFOSIZE]){
      JsGetPt = &JsFifo[0];   // wrap
   }
+  EndCritical(sr);
+  OS_ChannelGet(&JsFifoChannel);
   return(JSFIFOSUCCESS);
 }
 // number of elements in pointer FIFO
 // 0 to RXFIFOSIZE-1
 uint32_t JsFifo_Size(void){
   if(JsPutPt < JsGetPt){
-    return ((uint32_t)(JsPutPt-JsGetPt+(JSFIFOSIZE*sizeof(jsDataType)))/sizeof(jsDataType));
+    return ((uint32_t)(JsPutPt-JsGetPt+JSFIFOSIZE)); // pointer difference counts elements
   }
-  return ((uint32_t)(JsPutPt-JsGetPt)/sizeof(jsDataType));
+  return ((uint32_t)(JsPutPt-JsGetPt));
+}
+
+// Latest-value mailbox
+// JsMailboxSeq counts puts, JsMailboxLast is the count at the last read
+jsDataType static JsMailbox;
+unsigned long static JsMailboxSeq;
+unsigned long static JsMailboxLast;
+Sema4Type JsMailboxReady;
+ChannelType JsMailboxChannel; // statistics, a skipped value counts as a drop
+
+// initialize the mailbox, empty
+void JsMailbox_Init(void){ long sr;
+  sr = StartCritical();
+  OS_InitSemaphore(&JsMailboxReady, 0);
+  OS_ChannelInit(&JsMailboxChannel, "JsMailbox", 1, OS_CHANNEL_LATEST, 0);
+  JsMailboxSeq = JsMailboxLast = 0;
+  EndCritical(sr);
+}
+// replace the value in the mailbox, callable from an ISR
+void JsMailbox_Put(jsDataType data){ long sr;
+  sr = StartCritical();      // slot and sequence change together
+  JsMailbox = data;
+  JsMailboxSeq++;
+  OS_ChannelPut(&JsMailboxChannel, 1);
+  EndCritical(sr);
+  OS_bSignal(&JsMailboxReady);
+}
+// read the newest value, waiting at most timeout ms for one
+// newer than the last read, *skipped gets the number of values overwritten
+// return JSFIFOSUCCESS if successful, JSFIFOFAIL if nothing arrived in time
+int JsMailbox_GetTimeout(jsDataType *datapt, unsigned long *skipped, unsigned long timeout){
+  do{
+    if(OS_bWaitTimeout(&JsMailboxReady, timeout) == 0){
+      return(JSFIFOFAIL);    // Failed, producer is late
+    }
+  }while(JsMailbox_Take(datapt, skipped) == JSFIFOFAIL);
+  return(JSFIFOSUCCESS);
+}
+// read the newest value without waiting,
+// after OS_WaitAny has taken JsMailboxReady
+// a put between the wait and this read leaves the semaphore set
+// for a value already taken, which returns JSFIFOFAIL
+// return JSFIFOSUCCESS, or JSFIFOFAIL if that value was already read
+int JsMailbox_Take(jsDataType *datapt, unsigned long *skipped){ long sr;
+  unsigned long seq;
+  sr = StartCritical();
+  *datapt = JsMailbox;
+  seq = JsMailboxSeq;
+  EndCritical(sr);
+  if(seq == JsMailboxLast){
+    return(JSFIFOFAIL);      // nothing new
+  }
+  *skipped = seq - JsMailboxLast - 1;
+  JsMailboxLast = seq;
+  JsMailboxChannel.Gets++;
+  JsMailboxChannel.Drops += *skipped;
+  return(JSFIFOSUCCESS);
 }
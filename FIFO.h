@@ -28,6 +28,8 @@
 #ifndef __FIFO_H__
 #define __FIFO_H__
 
+#include "os.h"
+
 long StartCritical (void);    // previous I bit, disable interrupts
 void EndCritical(long sr);    // restore I bit to previous value
 
@@ -39,6 +41,7 @@ void EndCritical(long sr);    // restore I bit to previous value
 
 typedef struct {
 	uint16_t x,y;
+	unsigned long time;  // OS_Time when the ADC sample was taken
 }  jsDataType;
 
 // initialize pointer FIFO
@@ -46,11 +49,49 @@ void JsFifo_Init(void);
 // add element to end of pointer FIFO
 // return RXFIFOSUCCESS if successful
 int JsFifo_Put(jsDataType data);
+// remove the oldest element unread, used by the drop-oldest policy
+// return JSFIFOFAIL if the consumer already claimed every element
+int JsFifo_Discard(void);
 // remove element from front of pointer FIFO
 // return RXFIFOSUCCESS if successful
 int JsFifo_Get(jsDataType *datapt);
+// remove element from front of pointer FIFO, waiting at most timeout ms
+// return JSFIFOSUCCESS if successful, JSFIFOFAIL if nothing arrived in time
+int JsFifo_GetTimeout(jsDataType *datapt, unsigned long timeout);
+// remove element from front of pointer FIFO without waiting,
+// after OS_WaitAny has taken JsFifoAvailable
+// return JSFIFOSUCCESS
+int JsFifo_Take(jsDataType *datapt);
 // number of elements in pointer FIFO
 // 0 to RXFIFOSIZE-1
 uint32_t JsFifo_Size(void);
 
+// signaled once for every element put, so a thread can wait
+// for the FIFO together with other semaphores in OS_WaitAny
+extern Sema4Type JsFifoAvailable;
+// overflow policy and statistics, OS_ChannelPolicy changes the policy
+extern ChannelType JsFifoChannel;
+
+// Latest-value mailbox, a conflating channel for jsDataType
+// The producer overwrites one slot and bumps a sequence number,
+// so a put never fails and the consumer always reads the newest
+// value, plus how many older values it never saw.
+// initialize the mailbox, empty
+void JsMailbox_Init(void);
+// replace the value in the mailbox, callable from an ISR
+void JsMailbox_Put(jsDataType data);
+// read the newest value, waiting at most timeout ms for one
+// newer than the last read, *skipped gets the number of values overwritten
+// return JSFIFOSUCCESS if successful, JSFIFOFAIL if nothing arrived in time
+int JsMailbox_GetTimeout(jsDataType *datapt, unsigned long *skipped, unsigned long timeout);
+// read the newest value without waiting,
+// after OS_WaitAny has taken JsMailboxReady
+// return JSFIFOSUCCESS, or JSFIFOFAIL if that value was already read
+int JsMailbox_Take(jsDataType *datapt, unsigned long *skipped);
+
+// binary, signaled on every put, so a thread can wait
+// for the mailbox together with other semaphores in OS_WaitAny
+extern Sema4Type JsMailboxReady;
+extern ChannelType JsMailboxChannel;
+
 #endif //  __FIFO_H__
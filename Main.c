@@ -16,6 +16,8 @@
 #include "FIFO.h"
 #include "joystick.h"
 #include "PORTE.h"
+#include "dsp.h"
+#include "pipeline.h"
 
 // Constants
 #define BGCOLOR     					LCD_BLACK
@@ -24,27 +26,53 @@
 #define PSEUDOPERIOD         	8000000
 #define LIFETIME             	1000
 #define RUNLENGTH            	600 // 30 seconds run length
+#define DATATIMEOUT          	200 // ms Consumer waits for a sample, 4 sampling periods
+#define OVERSAMPLE           	4   // hardware averages 2^4 = 16 conversions per result
+#define CALSAMPLES           	64  // readings of the joystick at rest during calibration
+#define DEADMARGIN           	24  // ADC counts added to the measured noise for the dead zone
+#define MAXSPEED             	4   // pixels per sample at full deflection
+#define APERIODICBUDGET      	20  // ms of CPU for button work and commands...
+#define APERIODICPERIOD      	100 // ...in any window of this many ms
+#define PRODUCERWCET         	8000 // 100us estimate of Producer with CubeNumCalc, checked against its runs
 
 extern Sema4Type LCDFree;
-uint16_t origin[2]; 	// The original ADC value of x,y if the joystick is not touched, used as reference
+extern unsigned long ContextSwitches, Preemptions, HeldOff; // scheduler counts in os.c
+Sema4Type StatsRequest;	// Interpreter asks Consumer to show statistics on the LCD
+uint16_t origin[2]; 	// The calibrated ADC value of x,y if the joystick is not touched, used as reference
 int16_t x = 63;  			// horizontal position of the crosshair, initially 63
 int16_t y = 63;  			// vertical position of the crosshair, initially 63
 int16_t prevx, prevy;	// Previous x and y values of the crosshair
 uint8_t select;  			// joystick push
 uint8_t area[2];
 uint32_t PseudoCount;
+// Producer -> SampleQueue -> CubeNumCalc -> DisplayQueue -> Consumer
+pipeQueueType SampleQueue;		// feeds the CubeNumCalc callback stage, no storage
+pipeQueueType DisplayQueue;		// newest sample only, an unread one is dropped
+jsDataType DisplayBuf[1];
+pipeStageType CubeStage;
+medianType MedianX, MedianY;	// median of 3 removes single-sample ADC spikes
+#define VELOCITYSHIFT        	4    // 4096 ADC values map to 256 table entries
+#define VELOCITYSIZE         	(4096 >> VELOCITYSHIFT)
+int8_t VelocityX[VELOCITYSIZE];	// pixels per sample for each raw x, built by CrossHair_Init
+int8_t VelocityY[VELOCITYSIZE];	// pixels per sample for each raw y, built by CrossHair_Init
 
-unsigned long NumCreated;   		// Number of foreground threads created (OS_Kill does not decrement this)
+unsigned long NumCreated;   		// Number of foreground threads created and button jobs submitted (OS_Kill does not decrement this)
 unsigned long NumSamples;   		// Incremented every ADC sample, in Producer
 unsigned long UpdateWork;   		// Incremented every update on position values
 unsigned long Calculation;  		// Incremented every cube number calculation
 
 //---------------------User debugging-----------------------
-unsigned long DataLost;     // data sent by Producer, but not received by Consumer
+unsigned long DataLost;     // data sent by Producer, overwritten before Consumer read it
+unsigned long DataTimeouts; // times Consumer gave up waiting for Producer
 long MaxJitter;             // largest time jitter between interrupts in usec
 #define JITTERSIZE 64
 unsigned long const JitterSize=JITTERSIZE;
 unsigned long JitterHistogram[JITTERSIZE]={0,};
+#define LATENCYSIZE 64
+#define LATENCYBIN  250             // us per histogram bin, last bin holds everything slower
+unsigned long LatencyHistogram[LATENCYSIZE]={0,}; // sample to crosshair drawn
+unsigned long LatencyCount;         // samples drawn
+unsigned long MaxLatency;           // in us
 unsigned long TotalWithI1;
 unsigned short MaxWithI1;
 
@@ -55,20 +83,15 @@ void Device_Init(void){
 }
 //------------------Task 1--------------------------------
 // background thread executed at 20 Hz
+// Timer0A starts each conversion in hardware, Producer runs
+// from the ADC completion interrupt with the new sample
 //******** Producer *************** 
 int UpdatePosition(uint16_t rawx, uint16_t rawy, jsDataType* data){
-	if (rawx > origin[0]){
-		x = x + ((rawx - origin[0]) >> 9);
-	}
-	else{
-		x = x - ((origin[0] - rawx) >> 9);
-	}
-	if (rawy < origin[1]){
-		y = y + ((origin[1] - rawy) >> 9);
-	}
-	else{
-		y = y - ((rawy - origin[1]) >> 9);
-	}
+	int16_t sample;
+	sample = rawx; DSP_Median(&MedianX, &sample, &sample, 1); rawx = sample;
+	sample = rawy; DSP_Median(&MedianY, &sample, &sample, 1); rawy = sample;
+	x = x + VelocityX[rawx >> VELOCITYSHIFT];
+	y = y + VelocityY[rawy >> VELOCITYSHIFT];
 	if (x > 127){
 		x = 127;}
 	if (x < 0){
@@ -81,21 +104,18 @@ int UpdatePosition(uint16_t rawx, uint16_t rawy, jsDataType* data){
 	return 1;
 }
 
-void Producer(void){
-	uint16_t rawX,rawY; // raw adc value
-	uint8_t select;
+int ProducerLoad;       // Producer in the kernel's response time analysis
+void Producer(uint16_t rawX, uint16_t rawY, uint8_t select){
 	jsDataType data;
 	unsigned static long LastTime;  // time at previous ADC sample
 	unsigned long thisTime;         // time at current ADC sample
 	long jitter;                    // time between measured and expected, in us
 	if (NumSamples < RUNLENGTH){
-		BSP_Joystick_Input(&rawX,&rawY,&select);
 		thisTime = OS_Time();       // current time, 12.5 ns
 		UpdateWork += UpdatePosition(rawX,rawY,&data); // calculation work
+		data.time = thisTime;       // start of the sample-to-pixel latency
 		NumSamples++;               // number of samples
-		if(JsFifo_Put(data) == 0){ // send to consumer
-			DataLost++;
-		}
+		Pipe_Put(&SampleQueue, &data); // CubeNumCalc, then on to Consumer
 	//calculate jitter
 		if(UpdateWork > 1){    // ignore timing of first interrupt
 			unsigned long diff = OS_TimeDifference(LastTime,thisTime);
@@ -114,46 +134,71 @@ void Producer(void){
 			JitterHistogram[jitter]++; 
 		}
 		LastTime = thisTime;
+		OS_PeriodicTime(ProducerLoad, OS_TimeDifference(thisTime, OS_Time()));
 	}
 }
 
 //--------------end of Task 1-----------------------------
 
 //------------------Task 2--------------------------------
-// background thread executes with SW1 button
-// one foreground task created with button push
-// foreground treads run for 1 sec and die
+// coroutine wakes up with SW1 button
+// one job queued with each button push
+// jobs run for 1 sec, one after the other, on the coroutine thread
+// the coroutine thread runs on the Aperiodic server, so even a burst
+// of pushes takes at most APERIODICBUDGET ms of every APERIODICPERIOD
+CoType ButtonCo;
+Sema4Type ButtonPushes;  // jobs waiting to run
+ServerType Aperiodic;    // budget of ButtonWork and the Interpreter
 // ***********ButtonWork*************
-void ButtonWork(void){
-	uint32_t StartTime,CurrentTime,ElapsedTime;
-	StartTime = OS_MsTime();
-	ElapsedTime = 0;
-	OS_bWait(&LCDFree);
-	BSP_LCD_FillScreen(BGCOLOR);
-	while (ElapsedTime < LIFETIME){
+// locals do not survive OS_CO_SLEEP, so the times are static
+// LCDFree is held only while drawing, so Consumer draws in between;
+// the threshold is raised once OS_CO_WAIT has it, so the drawing is
+// neither preempted by Consumer, which would only block on LCDFree,
+// nor stopped by the server with the LCD held; while the LCD is busy
+// the coroutine waits in LCDFree's FIFO at the normal threshold
+int ButtonWork(CoType *co){
+	static uint32_t StartTime,CurrentTime,ElapsedTime;
+	OS_CO_BEGIN(co);
+	OS_ServerJoin(&Aperiodic);
+	for(;;){
+		OS_CO_WAIT(co, &ButtonPushes);
+		StartTime = OS_MsTime();
+		ElapsedTime = 0;
+		OS_CO_WAIT(co, &LCDFree);
+		OS_SetThreshold(1);
+		BSP_LCD_FillScreen(BGCOLOR);
+		OS_bSignal(&LCDFree);
+		OS_SetThreshold(OS_NOTHRESHOLD);
+		while (ElapsedTime < LIFETIME){
 
-		CurrentTime = OS_MsTime();
-		ElapsedTime = CurrentTime - StartTime;
-		BSP_LCD_Message(0,5,0,"Life Time:",LIFETIME);
-		BSP_LCD_Message(1,0,0,"Horizontal Area:",area[0]);
-		BSP_LCD_Message(1,1,0,"Vertical Area:",area[1]);
-		BSP_LCD_Message(1,2,0,"Elapsed Time:",ElapsedTime);
-		OS_Sleep(50);
+			CurrentTime = OS_MsTime();
+			ElapsedTime = CurrentTime - StartTime;
+			OS_CO_WAIT(co, &LCDFree);
+			OS_SetThreshold(1);
+			BSP_LCD_Message(0,5,0,"Life Time:",LIFETIME);
+			BSP_LCD_Message(1,0,0,"Horizontal Area:",area[0]);
+			BSP_LCD_Message(1,1,0,"Vertical Area:",area[1]);
+			BSP_LCD_Message(1,2,0,"Elapsed Time:",ElapsedTime);
+			OS_bSignal(&LCDFree);
+			OS_SetThreshold(OS_NOTHRESHOLD);
+			OS_CO_SLEEP(co, 50);
+		}
+		OS_CO_WAIT(co, &LCDFree);
+		OS_SetThreshold(1);
+		BSP_LCD_FillScreen(BGCOLOR);
+		OS_bSignal(&LCDFree);
+		OS_SetThreshold(OS_NOTHRESHOLD);
 	}
-	BSP_LCD_FillScreen(BGCOLOR);
-	OS_bSignal(&LCDFree);
-  OS_Kill();  // done, OS does not return from a Kill
-} 
+	OS_CO_END(co);
+}
 
 //************SW1Push*************
 // Called when SW1 Button pushed
-// Adds another foreground task
-// background threads execute once and return
+// queues another job for ButtonWork
 void SW1Push(void){
   if(OS_MsTime() > 20 ){ // debounce
-    if(OS_AddThread(&ButtonWork,128,4)){
-      NumCreated++; 
-    }
+    OS_Signal(&ButtonPushes);
+    NumCreated++; 
     OS_ClearMsTime();  // at least 20ms between touches
   }
 }
@@ -162,19 +207,87 @@ void SW1Push(void){
 
 //------------------Task 3--------------------------------
 
+//******** RecordLatency *************** 
+// add one sample's latency, the time from the ADC sample
+// until its crosshair is on the LCD, to the histogram
+// inputs:  latency in 12.5ns units
+// outputs: none
+void static RecordLatency(unsigned long time){
+	unsigned long us = time/80;
+	unsigned long bin = us/LATENCYBIN;
+	if(bin >= LATENCYSIZE){
+		bin = LATENCYSIZE-1;
+	}
+	LatencyHistogram[bin]++;
+	LatencyCount++;
+	if(us > MaxLatency){
+		MaxLatency = us;
+	}
+}
+
+//******** LatencyPercentile *************** 
+// latency that percent of the drawn samples did not exceed,
+// rounded up to the end of its histogram bin
+// inputs:  percent, 0 to 100
+// outputs: latency in us, 0 if nothing was drawn yet
+unsigned long LatencyPercentile(unsigned long percent){
+	unsigned long bin, sum = 0;
+	unsigned long goal = (LatencyCount*percent + 99)/100;
+	if(LatencyCount == 0){
+		return 0;
+	}
+	for(bin = 0; bin < LATENCYSIZE-1; bin++){
+		sum += LatencyHistogram[bin];
+		if(sum >= goal){
+			break;
+		}
+	}
+	if(bin == LATENCYSIZE-1){
+		return MaxLatency;      // in the overflow bin
+	}
+	return (bin+1)*LATENCYBIN;
+}
+
 //******** Consumer *************** 
 // foreground thread, accepts data from producer
 // Display crosshair and its positions
+// redraws the last position if Producer stops sending
+// shows statistics when the Interpreter asks for them
 // inputs:  none
 // outputs: none
 void Consumer(void){
+	Sema4Type *events[2];
+	int fresh;                  // data came from Producer, not a redraw
+	events[0] = &DisplayQueue.Available;
+	events[1] = &StatsRequest;
 	while(NumSamples < RUNLENGTH){
 		jsDataType data;
-		JsFifo_Get(&data);
+		switch(OS_WaitAny(events, 2, DATATIMEOUT)){
+			case 0:             // newest sample, older ones are not drawn
+				Pipe_Take(&DisplayQueue, &data);
+				DataLost = DisplayQueue.Channel.Drops;
+				fresh = 1;
+				break;
+			case 1:             // statistics refresh request
+				OS_bWait(&LCDFree);
+				BSP_LCD_Message(1, 3, 0, "Samples:", NumSamples);
+				BSP_LCD_Message(1, 4, 0, "Lost:", DataLost);
+				OS_bSignal(&LCDFree);
+				continue;
+			default:            // Producer is late or dead, refresh the stale crosshair
+				DataTimeouts++;
+				data.x = prevx;
+				data.y = prevy;
+				fresh = 0;
+				break;
+		}
 		OS_bWait(&LCDFree);
 			
 		BSP_LCD_DrawCrosshair(prevx, prevy, LCD_BLACK); // Draw a black crosshair
 		BSP_LCD_DrawCrosshair(data.x, data.y, LCD_RED); // Draw a red crosshair
+		if(fresh){
+			RecordLatency(OS_TimeDifference(data.time, OS_Time()));
+		}
 
 		BSP_LCD_Message(1, 5, 3, "X: ", x);		
 		BSP_LCD_Message(1, 5, 12, "Y: ", y);
@@ -189,24 +302,24 @@ void Consumer(void){
 //--------------end of Task 3-----------------------------
 
 //------------------Task 4--------------------------------
-// foreground thread that runs without waiting or sleeping
+// pipeline stage between sampling and display
 // it executes some calculation related to the position of crosshair 
 //******** CubeNumCalc *************** 
-// foreground thread, calculates the virtual cube number for the crosshair
-// never blocks, never sleeps, never dies
-// inputs:  none
-// outputs: none
-
-void CubeNumCalc(void){ 
-	uint16_t CurrentX,CurrentY;
-  while(1) {
-		if(NumSamples < RUNLENGTH){
-			CurrentX = x; CurrentY = y;
-			area[0] = CurrentX / 22;
-			area[1] = CurrentY / 20;
-			Calculation++;
-		}
-  }
+// calculates the virtual cube number for the crosshair
+// runs to completion in the ADC interrupt, on the same sample
+// that goes on to Consumer, so x and y always belong together
+// inputs:  n samples (jsDataType) at in
+// outputs: the same samples at out, returns n
+unsigned long CubeNumCalc(const void *in, unsigned long n, void *out){ 
+	const jsDataType *data = in;
+	unsigned long i;
+	for(i = 0; i < n; i++){
+		area[0] = data[i].x / 22;
+		area[1] = data[i].y / 20;
+		Calculation++;
+	}
+	memcpy(out, in, n*sizeof(jsDataType));
+	return n;
 }
 //--------------end of Task 4-----------------------------
 
@@ -220,8 +333,19 @@ void CubeNumCalc(void){
 //    print performance measures 
 //    time-jitter, number of data points lost, number of calculations performed
 //    i.e., NumSamples, NumCreated, MaxJitter, DataLost, UpdateWork, Calculations
+//    Latency shows sample-to-crosshair latency, p50/p99 within LATENCYBIN us
+//    Pipeline lists every stage with throughput, busy and stall time, and queue depth/high water
+//    Channels lists every kernel FIFO with its policy and put/get/drop/high-water counts
+//    Threads lists every thread with its priority, threshold, switches, CPU ms and stack high water,
+//      then the context switch counts and the stack needed with and without sharing
+//    Servers lists every sporadic server and reservation with its budget, CPU used
+//      and times it ran out
+//    Periodic lists every periodic load with its period, WCET and worst case response
+//      time in us, redoing the analysis with the run times measured so far
+char * const PolicyName[] = {"reject", "drop oldest", "block", "latest"}; // by OS_CHANNEL_ policy
 void Interpreter(void){
 	char command[80];
+	OS_ServerJoin(&Aperiodic);
   while(1){
     OutCRLF(); UART_OutString(">>");
 		UART_InString(command,79);
@@ -242,6 +366,14 @@ void Interpreter(void){
 			UART_OutString("DataLost: ");
 			UART_OutUDec(DataLost);
 		}
+		else if (!(strcmp(command,"DataTimeouts"))){
+			UART_OutString("DataTimeouts: ");
+			UART_OutUDec(DataTimeouts);
+		}
+		else if (!(strcmp(command,"ShowStats"))){
+			OS_bSignal(&StatsRequest);
+			UART_OutString("Stats on LCD");
+		}
 		else if (!(strcmp(command,"UpdateWork"))){
 			UART_OutString("UpdateWork: ");
 			UART_OutUDec(UpdateWork);
@@ -250,6 +382,97 @@ void Interpreter(void){
 			UART_OutString("Calculations: ");
 			UART_OutUDec(Calculation);
 		}
+		else if (!(strcmp(command,"Latency"))){
+			UART_OutString("Drawn: "); UART_OutUDec(LatencyCount);
+			UART_OutString(" p50: "); UART_OutUDec(LatencyPercentile(50));
+			UART_OutString("us p99: "); UART_OutUDec(LatencyPercentile(99));
+			UART_OutString("us max: "); UART_OutUDec(MaxLatency);
+			UART_OutString("us");
+		}
+		else if (!(strcmp(command,"Pipeline"))){
+			pipeStageType *st;
+			unsigned long ms = OS_MsTime();
+			for(st = Pipe_List(); st; st = st->next){
+				UART_OutString(st->name);
+				UART_OutString(" in: "); UART_OutUDec(st->In);
+				UART_OutString(" out: "); UART_OutUDec(st->Out);
+				UART_OutString(" per s: "); UART_OutUDec(ms ? (st->In*1000)/ms : 0);
+				UART_OutString(" busy us: "); UART_OutUDec(st->BusyTime/80);
+				UART_OutString(" stall ms: "); UART_OutUDec(st->StallTime/1000);
+				UART_OutString(" queue: "); UART_OutUDec(Pipe_Size(st->in));
+				UART_OutString("/"); UART_OutUDec(st->in->Channel.HighWater);
+				OutCRLF();
+			}
+		}
+		else if (!(strcmp(command,"Channels"))){
+			ChannelType *ch;
+			for(ch = OS_ChannelList(); ch; ch = ch->next){
+				UART_OutString(ch->name);
+				UART_OutString(" ("); UART_OutString(PolicyName[ch->Policy]);
+				UART_OutString(") put: "); UART_OutUDec(ch->Puts);
+				UART_OutString(" get: "); UART_OutUDec(ch->Gets);
+				UART_OutString(" drop: "); UART_OutUDec(ch->Drops);
+				UART_OutString(" high: "); UART_OutUDec(ch->HighWater);
+				UART_OutString("/"); UART_OutUDec(ch->Capacity);
+				OutCRLF();
+			}
+		}
+		else if (!(strcmp(command,"Threads"))){
+			ThreadStatsType st;
+			unsigned long id;
+			for(id = 0; OS_ThreadStats(id, &st) >= 0; id++){
+				if(st.state == 0){
+					continue;           // free tcb
+				}
+				UART_OutString("Thread "); UART_OutUDec(st.id);
+				UART_OutString(" pri: "); UART_OutUDec(st.priority);
+				UART_OutString(" threshold: "); UART_OutUDec(st.threshold);
+				UART_OutString(" switches: "); UART_OutUDec(st.Switches);
+				UART_OutString(" cpu ms: "); UART_OutUDec(st.CPU);
+				UART_OutString(" stack: "); UART_OutUDec(st.StackUsed);
+				if(st.Tickets){
+					UART_OutString(" tickets: "); UART_OutUDec(st.Tickets);
+				}
+				if(st.Jobs){
+					UART_OutString(" jobs: "); UART_OutUDec(st.Jobs);
+					UART_OutString(" misses: "); UART_OutUDec(st.Misses);
+				}
+				OutCRLF();
+			}
+			UART_OutString("Switches: "); UART_OutUDec(ContextSwitches);
+			UART_OutString(" preempt: "); UART_OutUDec(Preemptions);
+			UART_OutString(" held off: "); UART_OutUDec(HeldOff);
+			UART_OutString(" stack words: "); UART_OutUDec(OS_StackNeeded(0));
+			UART_OutString(" shared: "); UART_OutUDec(OS_StackNeeded(1));
+		}
+		else if (!(strcmp(command,"Servers"))){
+			ServerType *sv;
+			for(sv = OS_ServerList(); sv; sv = sv->next){
+				UART_OutString(sv->name);
+				UART_OutString(" budget: "); UART_OutUDec(sv->Budget/TIME_1MS);
+				UART_OutString("/"); UART_OutUDec(sv->Period);
+				UART_OutString(" ms used: "); UART_OutUDec(sv->UsedMs);
+				UART_OutString(" throttles: "); UART_OutUDec(sv->Throttles);
+				OutCRLF();
+			}
+		}
+		else if (!(strcmp(command,"Periodic"))){
+			periodicType pd;
+			unsigned long i;
+			int ok = OS_PeriodicCheck();
+			for(i = 0; OS_PeriodicStats(i, &pd); i++){
+				UART_OutString(pd.name);
+				UART_OutString(" period: "); UART_OutUDec(pd.period/80);
+				UART_OutString(" pri: "); UART_OutUDec(pd.priority);
+				UART_OutString(" wcet: "); UART_OutUDec(pd.wcet/80);
+				UART_OutString(" measured: "); UART_OutUDec(pd.MaxTime/80);
+				UART_OutString(" response: "); UART_OutUDec(pd.Response/80);
+				UART_OutString((pd.Response <= pd.period) ? " us ok" : " us MISSES");
+				OutCRLF();
+			}
+			UART_OutString("Utilization: "); UART_OutUDec(OS_PeriodicUtilization());
+			UART_OutString(ok ? "/1000 feasible" : "/1000 NOT feasible");
+		}
 		else if (!(strcmp(command,"FifoSize"))){
 			UART_OutString("JSFifoSize: ");
 			UART_OutUDec(JSFIFOSIZE);
@@ -262,9 +485,65 @@ void Interpreter(void){
 //--------------end of Task 5-----------------------------
 
 
+//******** CrossHair_Init *************** 
+// Calibrate the joystick and build the velocity tables.
+// The center is the mean of CALSAMPLES readings at rest, and
+// the spread of those readings plus DEADMARGIN is the dead zone.
+// Outside it the speed grows with the square of the deflection,
+// reaching MAXSPEED at the ADC limits 0 and 4095, so the ISR
+// only needs one lookup per axis.
+void static BuildVelocity(int8_t *table, uint16_t center, uint16_t dead, int sign){
+	int i;
+	long raw, deflection, range;
+	for(i = 0; i < VELOCITYSIZE; i++){
+		raw = (i << VELOCITYSHIFT) + (1 << (VELOCITYSHIFT-1)); // middle of the bin
+		deflection = raw - center;
+		range = (deflection > 0) ? (4095 - center) : center;
+		if(deflection < 0){
+			deflection = -deflection;
+		}
+		range = range - dead;
+		if((deflection <= dead) || (range <= 0)){
+			table[i] = 0;
+		}
+		else{
+			deflection = deflection - dead;
+			deflection = (MAXSPEED*deflection*deflection + range*range - 1)/(range*range);
+			if(raw < center){
+				deflection = -deflection;
+			}
+			table[i] = sign*deflection;
+		}
+	}
+}
 void CrossHair_Init(void){
+	int16_t rest[3];
+	uint16_t rawx, rawy, min[2], max[2];
+	unsigned long sum[2];
+	int i;
 	BSP_LCD_FillScreen(BGCOLOR);
-	BSP_Joystick_Input(&origin[0],&origin[1],&select);
+	BSP_Joystick_Average(OVERSAMPLE);
+	sum[0] = sum[1] = 0;
+	min[0] = min[1] = 4095;
+	max[0] = max[1] = 0;
+	for(i = 0; i < CALSAMPLES; i++){
+		BSP_Joystick_Input(&rawx,&rawy,&select);
+		sum[0] += rawx; sum[1] += rawy;
+		if(rawx < min[0]) min[0] = rawx;
+		if(rawx > max[0]) max[0] = rawx;
+		if(rawy < min[1]) min[1] = rawy;
+		if(rawy > max[1]) max[1] = rawy;
+	}
+	origin[0] = sum[0]/CALSAMPLES;
+	origin[1] = sum[1]/CALSAMPLES;
+	BuildVelocity(VelocityX, origin[0], (max[0]-min[0])/2 + DEADMARGIN, 1);
+	BuildVelocity(VelocityY, origin[1], (max[1]-min[1])/2 + DEADMARGIN, -1); // y grows downward
+	DSP_Median_Init(&MedianX, 3);	// start the filters at rest
+	rest[0] = rest[1] = rest[2] = origin[0];
+	DSP_Median(&MedianX, rest, rest, 3);
+	DSP_Median_Init(&MedianY, 3);
+	rest[0] = rest[1] = rest[2] = origin[1];
+	DSP_Median(&MedianY, rest, rest, 3);
 }
 
 //******************* Main Function**********
@@ -273,21 +552,32 @@ int main(void){
 	Device_Init();
   CrossHair_Init();
   DataLost = 0;        // lost data between producer and consumer
+  DataTimeouts = 0;
   NumSamples = 0;
   MaxJitter = 0;       // in 1us units
+  LatencyCount = 0;
+  MaxLatency = 0;
 
 //********initialize communication channels
-  JsFifo_Init();
+  Pipe_InitQueue(&SampleQueue, "Samples", 0, sizeof(jsDataType), 1, OS_CHANNEL_REJECT, 0);
+  Pipe_InitQueue(&DisplayQueue, "Display", DisplayBuf, sizeof(jsDataType), 1, OS_CHANNEL_DROPOLD, 0);
+  Pipe_AddStage(&CubeStage, "CubeNumCalc", &SampleQueue, &DisplayQueue, 1, &CubeNumCalc, PIPE_CALLBACK, 0, 0);
+  OS_InitSemaphore(&StatsRequest, 0);
 
 //*******attach background tasks***********
   OS_AddSW1Task(&SW1Push,2);
-  OS_AddPeriodicThread(&Producer,PERIOD,1); // 2 kHz real time sampling of PD3
+  ProducerLoad = OS_AddPeriodicLoad("Producer", PERIOD, 1, PRODUCERWCET); // runs timed in Producer
+  BSP_Joystick_Collect(PERIOD,1,&Producer); // 20 Hz timer-triggered sampling of the joystick
 	
   NumCreated = 0 ;
+// create the thread that runs ButtonWork
+  OS_InitSemaphore(&ButtonPushes, 0);
+  OS_InitServer(&Aperiodic, "Aperiodic", APERIODICBUDGET, APERIODICPERIOD);
+  OS_AddCoTask(&ButtonCo, &ButtonWork, 0);
+  OS_Co_Init(128, 4);
 // create initial foreground threads
   NumCreated += OS_AddThread(&Interpreter, 128,2); 
   NumCreated += OS_AddThread(&Consumer, 128,1); 
-	NumCreated += OS_AddThread(&CubeNumCalc, 128,1); 
  
   OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
 	return 0;            // this never executes
@@ -15,9 +15,17 @@
 #include "UART.h"
 #include "PLL.h"
 #include "PORTE.h"
+#include "joystick.h"
+#include "dsp.h"
+#include "pipeline.h"
 
 #define PERIOD TIME_500US   // DAS 2kHz sampling period in system time units
 
+// WCET estimates for OS_AddPeriodicThreadWCET, 12.5ns units, with margin
+// for the kernel calls made; OS_PeriodicCheck tests them against the runs
+#define WCET_SIGNAL    (TIME_1MS/50)  // 20us, counts and signals or sets flags
+#define WCET_ADDTHREAD (TIME_1MS/10)  // 100us, also creates a thread
+
 unsigned long NumCreated;   // Number of foreground threads created
                             // Note: OS_Kill does not decrement NumCreated.
 
@@ -75,9 +83,9 @@ int Testmain1(void){  // Testmain1
   OS_Init();          // initialize, disable interrupts
   PortE_Init();       // profile user threads
   NumCreated = 0 ;
-  NumCreated += OS_AddThread(&Thread1, 128, 1); 
-  NumCreated += OS_AddThread(&Thread2, 128, 2); 
-  NumCreated += OS_AddThread(&Thread3, 128, 3); 
+  NumCreated += OS_AddThread(&Thread1, 128, 1);  // equal priorities, round robin
+  NumCreated += OS_AddThread(&Thread2, 128, 1); 
+  NumCreated += OS_AddThread(&Thread3, 128, 1); 
   // Count1 Count2 Count3 should be equal or off by one at all times
   OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
   return 0;            // this never executes
@@ -110,9 +118,9 @@ int Testmain2(void){  // Testmain2
   OS_Init();           // initialize, disable interrupts
   PortE_Init();       // profile user threads
   NumCreated = 0 ;
-  NumCreated += OS_AddThread(&Thread1b, 128, 1); 
-  NumCreated += OS_AddThread(&Thread2b, 128, 2); 
-  NumCreated += OS_AddThread(&Thread3b, 128, 3); 
+  NumCreated += OS_AddThread(&Thread1b, 128, 1);  // equal priorities, round robin
+  NumCreated += OS_AddThread(&Thread2b, 128, 1); 
+  NumCreated += OS_AddThread(&Thread3b, 128, 1); 
   // Count1 Count2 Count3 should be equal on average
   // counts are larger than testmain1
   
@@ -141,7 +149,7 @@ void Thread2c(void){
   Count2 = 0;    
   Count5 = 0;    // Count2 + Count5 should equal Count1  
   NumCreated += OS_AddThread(&Thread5c, 128, 3); 
-  OS_AddPeriodicThread(&BackgroundThread1c, TIME_1MS, 0); 
+  OS_AddPeriodicThreadWCET(&BackgroundThread1c, "BackgroundThread1c", TIME_1MS, 0, WCET_SIGNAL); 
   for(;;){
     OS_Wait(&Readyc);
     Count2++;   // Count2 + Count5 should equal Count1
@@ -225,7 +233,7 @@ int main(void){   // Testmain4
   Count4 = 0;          
   OS_Init();           // initialize, disable interrupts
   NumCreated = 0 ;
-  OS_AddPeriodicThread(&BackgroundThread1d,PERIOD,0); 
+  OS_AddPeriodicThreadWCET(&BackgroundThread1d, "BackgroundThread1d", PERIOD, 0, WCET_SIGNAL); 
   OS_AddSW1Task(&BackgroundThread5d, 2);
   NumCreated += OS_AddThread(&Thread2d, 128, 2); 
   NumCreated += OS_AddThread(&Thread3d, 128, 3); 
@@ -233,3 +241,705 @@ int main(void){   // Testmain4
   OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
   return 0;            // this never executes
 }
+
+//*******************Fifth TEST**********
+// Stress test of OS_AddThread and OS_Kill
+// BackgroundThread1e creates a short-lived thread every 1 ms,
+// each one kills itself as soon as it runs
+// SW1 adds Thread4d threads on top of that, like ButtonWork in Main.c
+// Count1 should equal Count2 + Count5 + (number of live Thread4e)
+// Count5 counts creations refused because all TCBs were in use
+// Watch MaxAddThreadCritical and MaxKillCritical for the longest
+// time interrupts are masked inside OS_AddThread and OS_Kill
+void Thread4e(void){
+  Count2++;
+  OS_Kill();
+}
+void BackgroundThread1e(void){   // called at 1000 Hz
+  Count1++;
+  if(OS_AddThread(&Thread4e, 128, 3)){
+    NumCreated++;
+  }
+  else{
+    Count5++;
+  }
+}
+int Testmain5(void){   // Testmain5
+  Count1 = 0;
+  Count2 = 0;
+  Count4 = 0;
+  Count5 = 0;
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  OS_AddPeriodicThreadWCET(&BackgroundThread1e, "BackgroundThread1e", TIME_1MS, 0, WCET_ADDTHREAD); 
+  OS_AddSW1Task(&BackgroundThread5d, 2);
+  NumCreated += OS_AddThread(&Thread3d, 128, 3); 
+  NumCreated += OS_AddThread(&Thread4d, 128, 3); 
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Sixth TEST**********
+// Tests OS_AddThreadArg and the thread pool
+// One body, Thread3f, runs as two threads counting into Count3 and Count5
+// Count3 and Count5 should be equal on average
+// Each select press submits a job to the pool instead of creating a thread
+// Count4 increases by 640 every time select is pressed
+// NumCreated increase by 1 every time select is pressed
+void Thread3f(void *arg){
+  unsigned long *count = arg;
+  *count = 0;
+  for(;;){
+    (*count)++;
+  }
+}
+void Job4f(void *arg){ int i;
+  for(i=0;i<(int)arg;i++){
+    Count4++;
+    OS_Sleep(1);
+  }
+}
+void BackgroundThread5f(void){   // called when Select button pushed
+  NumCreated += OS_ThreadPool_Submit(&Job4f, (void *)640); 
+}
+int Testmain6(void){   // Testmain6
+  Count4 = 0;          
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  OS_AddPeriodicThreadWCET(&BackgroundThread1d, "BackgroundThread1d", PERIOD, 0, WCET_SIGNAL); 
+  OS_AddSW1Task(&BackgroundThread5f, 2);
+  OS_ThreadPool_Init(2, 128, 3);
+  NumCreated += OS_AddThread(&Thread2d, 128, 2); 
+  NumCreated += OS_AddThreadArg(&Thread3f, &Count3, 128, 3); 
+  NumCreated += OS_AddThreadArg(&Thread3f, &Count5, 128, 3); 
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Seventh TEST**********
+// Tests event groups
+// BackgroundThread1g sets SAMPLE every 1 ms and SECOND every 1000 ms
+// select press sets BUTTON
+// Thread2g consumes SAMPLE, flags do not count so Count2 <= Count1,
+//   Count1-Count2 is the number of samples merged while Thread2g was busy
+// Thread4g waits for BUTTON and SECOND together, Count4 increases
+//   by 1 within a second of each select press
+// Count5 increases every 2 seconds without a press
+#define SAMPLE  0x01
+#define BUTTON  0x02
+#define SECOND  0x04
+EventGroupType Events;
+void BackgroundThread1g(void){   // called at 1000 Hz
+static int i=0;
+  Count1++;
+  OS_FlagSet(&Events, SAMPLE);
+  i++;
+  if(i==1000){
+    i = 0;
+    OS_FlagSet(&Events, SECOND);
+  }
+}
+void Thread2g(void){
+  Count2 = 0;          
+  for(;;){
+    OS_FlagWait(&Events, SAMPLE, OS_FLAG_ANY|OS_FLAG_CLEAR, OS_FOREVER);
+    Count2++;     
+  }
+}
+void Thread4g(void){
+  for(;;){
+    if(OS_FlagWait(&Events, BUTTON|SECOND, OS_FLAG_ALL|OS_FLAG_CLEAR, 2000)){
+      Count4++;
+    }
+    else{
+      Count5++;   // timed out
+    }
+  }
+}
+void BackgroundThread5g(void){   // called when Select button pushed
+  OS_FlagSet(&Events, BUTTON);
+}
+int Testmain7(void){   // Testmain7
+  Count1 = 0;
+  Count4 = 0;          
+  Count5 = 0;
+  OS_Init();           // initialize, disable interrupts
+  OS_InitEventGroup(&Events);
+  NumCreated = 0 ;
+  OS_AddPeriodicThreadWCET(&BackgroundThread1g, "BackgroundThread1g", TIME_1MS, 0, WCET_SIGNAL); 
+  OS_AddSW1Task(&BackgroundThread5g, 2);
+  NumCreated += OS_AddThread(&Thread2g, 128, 2); 
+  NumCreated += OS_AddThread(&Thread3d, 128, 3); 
+  NumCreated += OS_AddThread(&Thread4g, 128, 3); 
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Eighth TEST**********
+// Measures the uncontended semaphore paths, in bus cycles (12.5ns)
+// WaitSignalCycles is one OS_Wait plus one OS_Signal with the
+// LDREX/STREX fast paths, CriticalCycles is the same pair done
+// with interrupts masked, like the kernel path
+// SwitchCycles is one OS_Suspend to Thread2h and back, two passes
+// through SysTick_Handler and Scheduler
+// the smallest of many runs is kept, so interrupts do not count
+// build with OS_RAMFUNC 0 and 1 to see what SRAM placement saves;
+// for 1 also assemble osasm.s with --pd "OS_RAMFUNC SETL {TRUE}",
+// the link fails if the two settings differ
+long StartCritical(void);    // previous I bit, disable interrupts
+void EndCritical(long sr);    // restore I bit to previous value
+#define BENCHRUNS 100
+Sema4Type Bench;
+unsigned long WaitSignalCycles = 0xFFFFFFFF;
+unsigned long CriticalCycles = 0xFFFFFFFF;
+unsigned long SwitchCycles = 0xFFFFFFFF;
+void CriticalWait(Sema4Type *semaPt){
+  long sr;
+  sr = StartCritical();
+  if(semaPt->Value > 0){
+    semaPt->Value = semaPt->Value - 1;
+  }
+  EndCritical(sr);
+}
+void CriticalSignal(Sema4Type *semaPt){
+  long sr;
+  sr = StartCritical();
+  semaPt->Value = semaPt->Value + 1;
+  EndCritical(sr);
+}
+void Thread1h(void){ int i;
+  unsigned long start, time;
+  OS_InitSemaphore(&Bench, 1);
+  for(;;){
+    start = OS_Time();
+    for(i=0;i<BENCHRUNS;i++){
+      OS_Wait(&Bench);
+      OS_Signal(&Bench);
+    }
+    time = OS_TimeDifference(start, OS_Time())/BENCHRUNS;
+    if(time < WaitSignalCycles){
+      WaitSignalCycles = time;
+    }
+    start = OS_Time();
+    for(i=0;i<BENCHRUNS;i++){
+      CriticalWait(&Bench);
+      CriticalSignal(&Bench);
+    }
+    time = OS_TimeDifference(start, OS_Time())/BENCHRUNS;
+    if(time < CriticalCycles){
+      CriticalCycles = time;
+    }
+    start = OS_Time();
+    for(i=0;i<BENCHRUNS;i++){
+      OS_Suspend();
+    }
+    time = OS_TimeDifference(start, OS_Time())/BENCHRUNS;
+    if(time < SwitchCycles){
+      SwitchCycles = time;
+    }
+    Count1++;
+  }
+}
+void Thread2h(void){
+  for(;;){
+    OS_Suspend();              // straight back to Thread1h
+  }
+}
+int Testmain8(void){   // Testmain8
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  NumCreated += OS_AddThread(&Thread1h, 128, 1); 
+  NumCreated += OS_AddThread(&Thread2h, 128, 1); 
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Ninth TEST**********
+// Streams the microphone at 8 kHz and the accelerometer at 1 kHz
+// through uDMA ping-pong blocks
+// Thread1i and Thread2i read each block in place, Thread3i only
+// counts, so Count3 shows how much CPU the streams leave over
+// MicStream.Overruns or AccelStream.Overruns nonzero means a consumer was too slow
+// the ADC interrupt masks stay clear, the vectors run only on uDMA block
+// done, so Interrupts should equal Blocks
+unsigned long MicPeakToPeak;
+unsigned long AccelAverage[3];
+void Thread1i(void){ int i;
+  uint16_t *pt, min, max;
+  for(;;){
+    pt = BSP_Microphone_GetBlock();
+    min = max = pt[0];
+    for(i=1;i<MIC_BLOCKSIZE;i++){
+      if(pt[i] < min) min = pt[i];
+      if(pt[i] > max) max = pt[i];
+    }
+    BSP_Microphone_ReleaseBlock();
+    MicPeakToPeak = max - min;
+    Count1++;
+  }
+}
+void Thread2i(void){ int i;
+  uint16_t *pt;
+  unsigned long sum[3];
+  for(;;){
+    pt = BSP_Accelerometer_GetBlock();
+    sum[0] = sum[1] = sum[2] = 0;
+    for(i=0;i<ACCEL_BLOCKSIZE*3;i=i+3){
+      sum[0] += pt[i];
+      sum[1] += pt[i+1];
+      sum[2] += pt[i+2];
+    }
+    BSP_Accelerometer_ReleaseBlock();
+    for(i=0;i<3;i++){
+      AccelAverage[i] = sum[i]/ACCEL_BLOCKSIZE;
+    }
+    Count2++;
+  }
+}
+void Thread3i(void){
+  for(;;){
+    Count3++;
+  }
+}
+int Testmain9(void){   // Testmain9
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  BSP_Microphone_Stream(8000, 2);
+  BSP_Accelerometer_Stream(1000, 2);
+  NumCreated += OS_AddThread(&Thread1i, 128, 1); 
+  NumCreated += OS_AddThread(&Thread2i, 128, 1); 
+  NumCreated += OS_AddThread(&Thread3i, 128, 2);  // spins, CPU left over
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Tenth TEST**********
+// Cycles per sample of the dsp.c kernels on one block
+// of microphone-sized data, in bus cycles (12.5ns)
+// the smallest of many runs is kept, so interrupts do not count
+#define DSPBLOCK 256
+#define DSPTAPS 16
+int16_t DspIn[DSPBLOCK], DspOut[DSPBLOCK];
+int16_t const LowPass[DSPTAPS]={ // 16-tap low pass, Q15, unity DC gain
+  -113,-207,-154,319,1488,3293,5220,6535,
+  6535,5220,3293,1488,319,-154,-207,-113};
+int16_t const Biquad[5]={ // 2nd order Butterworth low pass, Q14, cutoff fs/10
+  1105,2210,1105,18722,-6757};
+int16_t FirState[2*DSPTAPS], DecimateState[2*DSPTAPS], IirState[4], AverageBuf[8];
+firType Fir;
+iirType Iir;
+averageType Average;
+medianType Median;
+decimateType Decimate;
+unsigned long FromADCCycles = 0xFFFFFFFF; // per sample
+unsigned long FIRCycles = 0xFFFFFFFF;
+unsigned long IIRCycles = 0xFFFFFFFF;
+unsigned long AverageCycles = 0xFFFFFFFF;
+unsigned long MedianCycles = 0xFFFFFFFF;
+unsigned long DecimateCycles = 0xFFFFFFFF;
+void DspBench(unsigned long *cycles, unsigned long start){
+  unsigned long time = OS_TimeDifference(start, OS_Time())/DSPBLOCK;
+  if(time < *cycles){
+    *cycles = time;
+  }
+}
+void Thread1j(void){ int i;
+  unsigned long start;
+  for(i=0;i<DSPBLOCK;i++){
+    DspIn[i] = (i*2749)%4096;      // scattered 12-bit values
+  }
+  DSP_FIR_Init(&Fir, LowPass, FirState, DSPTAPS);
+  DSP_IIR_Init(&Iir, Biquad, IirState, 1);
+  DSP_Average_Init(&Average, AverageBuf, 8);
+  DSP_Median_Init(&Median, 5);
+  DSP_Decimate_Init(&Decimate, LowPass, DecimateState, DSPTAPS, 4);
+  for(;;){
+    start = OS_Time();
+    DSP_FromADC((uint16_t *)DspIn, DspOut, DSPBLOCK, 2048);
+    DspBench(&FromADCCycles, start);
+    start = OS_Time();
+    DSP_FIR(&Fir, DspOut, DspOut, DSPBLOCK);
+    DspBench(&FIRCycles, start);
+    start = OS_Time();
+    DSP_IIR(&Iir, DspOut, DspOut, DSPBLOCK);
+    DspBench(&IIRCycles, start);
+    start = OS_Time();
+    DSP_Average(&Average, DspOut, DspOut, DSPBLOCK);
+    DspBench(&AverageCycles, start);
+    start = OS_Time();
+    DSP_Median(&Median, DspOut, DspOut, DSPBLOCK);
+    DspBench(&MedianCycles, start);
+    start = OS_Time();
+    DSP_Decimate(&Decimate, DspOut, DspOut, DSPBLOCK);
+    DspBench(&DecimateCycles, start);
+    Count1++;
+  }
+}
+int Testmain10(void){   // Testmain10
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  NumCreated += OS_AddThread(&Thread1j, 128, 1); 
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Eleventh TEST**********
+// Three-stage pipeline at 1 kHz
+// BackgroundThread1k -> RawQueue -> Smooth (thread, batches of 4)
+//   -> SmoothQueue -> Check (callback sink)
+// Count1 is samples made, Count2 is samples checked, and the
+// Pipeline stage counters show throughput and stall time
+#define SMOOTHBATCH 4
+pipeQueueType RawQueue, SmoothQueue;
+int16_t RawBuf[16];
+pipeStageType SmoothStage, CheckStage;
+averageType Smoother;
+int16_t SmootherBuf[4];
+unsigned long CheckErrors;   // smoothed value out of the input range
+void BackgroundThread1k(void){
+  int16_t sample = (Count1&0xFF)*100;
+  Pipe_Put(&RawQueue, &sample);
+  Count1++;
+}
+unsigned long Smooth(const void *in, unsigned long n, void *out){
+  DSP_Average(&Smoother, in, out, n);
+  return n;
+}
+unsigned long Check(const void *in, unsigned long n, void *out){
+  const int16_t *pt = in;
+  unsigned long i;
+  for(i=0;i<n;i++){
+    if((pt[i] < 0) || (pt[i] > 25500)){
+      CheckErrors++;
+    }
+    Count2++;
+  }
+  return 0;
+}
+int Testmain11(void){   // Testmain11
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  DSP_Average_Init(&Smoother, SmootherBuf, 4);
+  Pipe_InitQueue(&RawQueue, "Raw", RawBuf, sizeof(int16_t), 16, OS_CHANNEL_REJECT, 0);
+  Pipe_InitQueue(&SmoothQueue, "Smoothed", 0, sizeof(int16_t), 1, OS_CHANNEL_REJECT, 0);
+  Pipe_AddStage(&SmoothStage, "Smooth", &RawQueue, &SmoothQueue, SMOOTHBATCH, &Smooth, PIPE_THREAD, 128, 1);
+  Pipe_AddStage(&CheckStage, "Check", &SmoothQueue, 0, 1, &Check, PIPE_CALLBACK, 0, 0);
+  OS_AddPeriodicThreadWCET(&BackgroundThread1k, "BackgroundThread1k", TIME_1MS, 0, WCET_SIGNAL);
+  NumCreated += OS_AddThread(&Thread3i, 128, 2);  // spins, CPU left over
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Twelfth TEST**********
+// ISR to thread response time, 12.5ns units
+// a 1 kHz ISR signals two threads while Thread3i spins at priority 2
+// Thread1l outranks the spinner, so the wake preempts it at once:
+//   WakeMax1 should be a few us (a few hundred units)
+// Thread2l has the spinner's priority, so it waits for the time slice:
+//   WakeMax2 approaches TIME_2MS
+Sema4Type Wake1, Wake2;
+unsigned long WakeStart;      // OS_Time in the ISR
+unsigned long WakeMax1, WakeSum1, WakeMax2, WakeSum2;
+void BackgroundThread1l(void){   // called at 1000 Hz
+  WakeStart = OS_Time();
+  OS_Signal(&Wake1);
+  OS_Signal(&Wake2);
+}
+void Thread1l(void){ unsigned long time;
+  for(;;){
+    OS_Wait(&Wake1);
+    time = OS_TimeDifference(WakeStart, OS_Time());
+    Count1++;                    // WakeSum1/Count1 is the average
+    WakeSum1 += time;
+    if(time > WakeMax1){
+      WakeMax1 = time;
+    }
+  }
+}
+void Thread2l(void){ unsigned long time;
+  for(;;){
+    OS_Wait(&Wake2);
+    time = OS_TimeDifference(WakeStart, OS_Time());
+    Count2++;                    // WakeSum2/Count2 is the average
+    WakeSum2 += time;
+    if(time > WakeMax2){
+      WakeMax2 = time;
+    }
+  }
+}
+int Testmain12(void){   // Testmain12
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  OS_InitSemaphore(&Wake1, 0);
+  OS_InitSemaphore(&Wake2, 0);
+  OS_AddPeriodicThreadWCET(&BackgroundThread1l, "BackgroundThread1l", TIME_1MS, 0, WCET_SIGNAL);
+  NumCreated += OS_AddThread(&Thread1l, 128, 1); 
+  NumCreated += OS_AddThread(&Thread2l, 128, 2); 
+  NumCreated += OS_AddThread(&Thread3i, 128, 2);  // spins
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Thirteenth TEST**********
+// EDF against fixed priority on the same deadline threads
+// periods 5, 7 and 9 ms, 2 ms of work each, deadline = period
+// utilization 2/5+2/7+2/9 = 0.91, below 1 so EDF meets every deadline,
+// with deadline monotonic priorities 1, 2, 3 the 9 ms thread has a
+// response time of 10 ms, so build once with OS_EDF 1 and once with
+// OS_EDF 0 and compare EdfMisses, the 9 ms thread misses only with 0
+// the work loop is timed before OS_Launch, so each job is 2 ms of CPU
+#define CALIBRATERUNS 10000    // loop passes timed to find WorkPerMs
+unsigned long WorkPerMs;       // loop passes in 1 ms, measured
+unsigned long EdfId[3];        // thread ids, for OS_ThreadStats
+unsigned long EdfJobs[3], EdfMisses[3];
+void Work(unsigned long n){ volatile unsigned long i;
+  for(i=0;i<n;i++){
+  }
+}
+// time Work with interrupts disabled, after OS_Init starts OS_Time
+void CalibrateWork(void){ unsigned long start, time;
+  start = OS_Time();
+  Work(CALIBRATERUNS);
+  time = OS_TimeDifference(start, OS_Time());
+  WorkPerMs = (CALIBRATERUNS*TIME_1MS)/time;
+}
+void Thread1m(void){
+  EdfId[0] = OS_Id();
+  for(;;){
+    Work(2*WorkPerMs);
+    Count1++;
+    OS_WaitNextPeriod();
+  }
+}
+void Thread2m(void){
+  EdfId[1] = OS_Id();
+  for(;;){
+    Work(2*WorkPerMs);
+    Count2++;
+    OS_WaitNextPeriod();
+  }
+}
+void Thread3m(void){
+  EdfId[2] = OS_Id();
+  for(;;){
+    Work(2*WorkPerMs);
+    Count3++;
+    OS_WaitNextPeriod();
+  }
+}
+void Thread4m(void){ ThreadStatsType st; unsigned long i;
+  for(;;){
+    OS_Sleep(100);               // runs in the 9% left over
+    for(i=0;i<3;i++){
+      OS_ThreadStats(EdfId[i], &st);
+      EdfJobs[i] = st.Jobs;
+      EdfMisses[i] = st.Misses;
+    }
+  }
+}
+int Testmain13(void){   // Testmain13
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  CalibrateWork();
+  NumCreated += OS_AddDeadlineThread(&Thread1m, 128, 5, 5, 1);
+  NumCreated += OS_AddDeadlineThread(&Thread2m, 128, 7, 7, 2);
+  NumCreated += OS_AddDeadlineThread(&Thread3m, 128, 9, 9, 3);
+  NumCreated += OS_AddThread(&Thread4m, 128, 5);
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Fourteenth TEST**********
+// proportional share below the real-time priorities
+// three CPU burners with 100, 200 and 300 tickets, so Share should
+// settle near 167, 333 and 500 per mille; after 10 s Thread1n is
+// raised to 300 tickets, and the shares move to 375, 250 and 375
+unsigned long ShareId[3];      // thread ids, for OS_ThreadStats
+unsigned long Share[3];        // per mille of the CPU the three used in the last second
+unsigned long ShareRetick;     // 1 to raise Thread1n to 300 tickets after 10 s
+void Thread1n(void){
+  ShareId[0] = OS_Id();
+  for(;;){
+    Count1++;
+  }
+}
+void Thread2n(void){
+  ShareId[1] = OS_Id();
+  for(;;){
+    Count2++;
+  }
+}
+void Thread3n(void){
+  ShareId[2] = OS_Id();
+  for(;;){
+    Count3++;
+  }
+}
+void Thread4n(void){ ThreadStatsType st; unsigned long i, total, seconds = 0;
+  unsigned long last[3] = {0, 0, 0}, used[3];
+  for(;;){
+    OS_Sleep(1000);
+    total = 0;
+    for(i=0;i<3;i++){
+      OS_ThreadStats(ShareId[i], &st);
+      used[i] = st.CPU - last[i];
+      last[i] = st.CPU;
+      total += used[i];
+    }
+    for(i=0;i<3;i++){
+      Share[i] = (1000*used[i])/total;
+    }
+    seconds++;
+    if(ShareRetick && (seconds == 10)){
+      OS_SetTickets(ShareId[0], 300);
+    }
+  }
+}
+int Testmain14(void){   // Testmain14
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  ShareRetick = 1;
+  NumCreated += OS_AddShareThread(&Thread1n, 128, 100);
+  NumCreated += OS_AddShareThread(&Thread2n, 128, 200);
+  NumCreated += OS_AddShareThread(&Thread3n, 128, 300);
+  NumCreated += OS_AddThread(&Thread4n, 128, 2);
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Fourteenth TEST, sleeper**********
+// Testmain14 with equal tickets, where Thread1p runs 2 s then sleeps
+// 5 s, longer than SharePass takes to wrap (2^31 at 655 per us of
+// 100-ticket CPU is about 3.3 s); every second it is awake Share[0]
+// should be near 333, not 0 while the others catch up, nor 1000
+void Thread1p(void){ unsigned long start;
+  ShareId[0] = OS_Id();
+  for(;;){
+    start = OS_MsTime();
+    while((OS_MsTime() - start) < 2000){
+      Count1++;
+    }
+    OS_Sleep(5000);
+  }
+}
+int Testmain14p(void){   // Testmain14p
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  ShareRetick = 0;
+  NumCreated += OS_AddShareThread(&Thread1p, 128, 100);
+  NumCreated += OS_AddShareThread(&Thread2n, 128, 100);
+  NumCreated += OS_AddShareThread(&Thread3n, 128, 100);
+  NumCreated += OS_AddThread(&Thread4n, 128, 2);
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Fifteenth TEST**********
+// CPU reservation keeps a runaway thread to 2 ms every 10 ms
+// Thread1o spins at priority 1 and would starve Thread3o at priority 2,
+// Thread2o puts it on a reservation once it is running, after that
+// Count1/(Count1+Count2) should stay near 0.2 and Throttled grow by 100 per second
+ServerType Reserve;
+unsigned long RunawayId;
+unsigned long Throttled;       // calls of the throttle callback
+void RunawayThrottled(unsigned long id){
+  Throttled++;
+}
+void Thread1o(void){
+  RunawayId = OS_Id();
+  for(;;){
+    Count1++;
+  }
+}
+void Thread2o(void){
+  OS_Sleep(1);                 // Thread1o has its id by now
+  OS_ServerAttach(RunawayId, &Reserve);
+  OS_Kill();
+}
+void Thread3o(void){
+  for(;;){
+    Count2++;
+  }
+}
+int Testmain15(void){   // Testmain15
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  OS_InitReservation(&Reserve, "Runaway", 2, 10, &RunawayThrottled);
+  NumCreated += OS_AddThread(&Thread1o, 128, 1);
+  NumCreated += OS_AddThread(&Thread2o, 128, 0);
+  NumCreated += OS_AddThread(&Thread3o, 128, 2);
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Sixteenth TEST**********
+// time-triggered schedule table, 100 ms major frame
+// sampling at 20 Hz (0 and 50 ms), a display update at 25 ms and
+// stats at 75 ms, with work once a second, while Thread3i spins
+// in the time left over; OS_CyclicStats shows every entry ran
+// once a frame (twice for sampling) with no Overruns
+unsigned long Samples, Updates, Reports;
+void CyclicSample(void){
+  Samples++;
+}
+void CyclicDisplay(void){
+  Updates++;
+}
+void CyclicStatsTask(void){ static unsigned long frames;
+  frames++;
+  if(frames == 10){              // once a second
+    frames = 0;
+    Reports++;
+  }
+}
+const CyclicEntryType Schedule[] = {
+  { 0, &CyclicSample},
+  {25, &CyclicDisplay},
+  {50, &CyclicSample},
+  {75, &CyclicStatsTask}
+};
+int Testmain16(void){   // Testmain16
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  OS_CyclicStart(Schedule, 4, 100, 1);
+  NumCreated += OS_AddThread(&Thread3i, 128, 2);  // spins in the idle slots
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
+
+//*******************Seventeenth TEST**********
+// admission of periodic loads at add time, on top of the kernel tick
+// (TIME_1MS/20 of every 1 ms at priority 2)
+// BackgroundThread1q declares half of every 1 ms, which fits;
+// another half of every 1 ms, or 1 ms of every 2 ms, would take the
+// CPU past 100% and must be refused, with no timer used;
+// a small 2 ms load still fits after the refusals
+// AdmitErrors should be 0 and Count1 grow by 1000 per second
+unsigned long AdmitErrors;     // results that differ from the above
+void BackgroundThread1q(void){   // called at 1000 Hz
+  Count1++;
+}
+int Testmain17(void){   // Testmain17
+  Count1 = 0;
+  AdmitErrors = 0;
+  OS_Init();           // initialize, disable interrupts
+  NumCreated = 0 ;
+  if(OS_AddPeriodicThreadWCET(&BackgroundThread1q, "BackgroundThread1q", TIME_1MS, 0, TIME_500US) != 1){
+    AdmitErrors++;     // 55%, feasible
+  }
+  if(OS_AddPeriodicLoad("Overload", TIME_1MS, 1, TIME_500US) != -1){
+    AdmitErrors++;     // 105%
+  }
+  if(OS_AddPeriodicThreadWCET(&BackgroundThread1q, "Overload", TIME_2MS, 1, TIME_1MS) != 0){
+    AdmitErrors++;     // 105%, and Timer4A stays free
+  }
+  if(OS_AddPeriodicLoad("Fits", TIME_2MS, 3, TIME_1MS/10) < 0){
+    AdmitErrors++;     // 60%, the refused loads left nothing behind
+  }
+  if(OS_PeriodicUtilization() != 600){
+    AdmitErrors++;     // tick 50, BackgroundThread1q 500, Fits 50, in 0.1%
+  }
+  NumCreated += OS_AddThread(&Thread3d, 128, 3);  // spins
+  OS_Launch(TIME_2MS); // doesn't return, interrupts enabled in here
+  return 0;            // this never executes
+}
@@ -99,10 +99,11 @@ void UART_Init(void){
   NVIC_EN0_R = NVIC_EN0_INT5;           // enable interrupt 5 in NVIC
 }
 // copy from hardware RX FIFO to software RX FIFO
-// stop when hardware RX FIFO is empty or software RX FIFO is full
+// stop when hardware RX FIFO is empty, a full software RX FIFO
+// drops characters by the policy of Rx_UARTChannel, and counts them
 void static copyHardwareToSoftware(void){
   char letter;
-  while(((UART0_FR_R&UART_FR_RXFE) == 0) && (Rx_UARTFifo_Size() < (FIFOSIZE - 1))){
+  while((UART0_FR_R&UART_FR_RXFE) == 0){
     letter = UART0_DR_R;
     Rx_UARTFifo_Put(letter);
   }
@@ -124,9 +125,9 @@ char UART_InChar(void){
   return(letter);
 }
 // output ASCII character to UART
-// spin if TxFifo is full
+// if TxFifo is full, wait or drop by the policy of Tx_UARTChannel
 void UART_OutChar(char data){
-  while(Tx_UARTFifo_Put(data) == FIFOFAIL){};
+  Tx_UARTFifo_Put(data);
   UART0_IM_R &= ~UART_IM_TXIM;          // disable TX FIFO interrupt
   copySoftwareToHardware();
   UART0_IM_R |= UART_IM_TXIM;           // enable TX FIFO interrupt
@@ -39,25 +39,33 @@ unsigned long volatile Tx_UARTPutI;// put next
 unsigned long volatile Tx_UARTGetI;// get next
 tx_UARTDataType static Tx_UARTFifo[TXFIFOSIZE];
 
-Sema4Type Tx_UARTRoomType;
-	
+ChannelType Tx_UARTChannel;   // its Room semaphore counts free places
+
 // initialize index FIFO
 void Tx_UARTFifo_Init(void){ long sr;
   sr = StartCritical(); // make atomic
-  OS_InitSemaphore(&Tx_UARTRoomType, TXFIFOSIZE);
+  OS_ChannelInit(&Tx_UARTChannel, "UART Tx", TXFIFOSIZE, OS_CHANNEL_BLOCK, OS_FOREVER);
   Tx_UARTPutI = Tx_UARTGetI = 0;  // Empty
   EndCritical(sr);
 }
 // add element to end of index FIFO
 // return TXFIFOSUCCESS if successful
-int Tx_UARTFifo_Put(tx_UARTDataType data){
-  OS_Wait(&Tx_UARTRoomType);
-	
-	if((Tx_UARTPutI-Tx_UARTGetI) & ~(TXFIFOSIZE-1)){
+int Tx_UARTFifo_Put(tx_UARTDataType data){ long sr;
+  int room;
+  while((room = OS_ChannelReserve(&Tx_UARTChannel)) == OS_CHANNEL_REPLACE){
+    sr = StartCritical();    // discard the oldest character
+    if(Tx_UARTPutI != Tx_UARTGetI){
+      Tx_UARTGetI++;
+    }
+    EndCritical(sr);
+    OS_Signal(&Tx_UARTChannel.Room);
+  }
+  if(room == OS_CHANNEL_FULL){
     return(TXFIFOFAIL); // Failed, fifo full
   }
   Tx_UARTFifo[Tx_UARTPutI&(TXFIFOSIZE-1)] = data; // put
   Tx_UARTPutI++;  // Success, update
+  OS_ChannelPut(&Tx_UARTChannel, Tx_UARTPutI-Tx_UARTGetI);
   return(TXFIFOSUCCESS);
 }
 // remove element from front of index FIFO
@@ -68,8 +76,7 @@ int Tx_UARTFifo_Get(tx_UARTDataType *datapt){
   }
   *datapt = Tx_UARTFifo[Tx_UARTGetI&(TXFIFOSIZE-1)];
   Tx_UARTGetI++;  // Success, update
-  OS_Signal(&Tx_UARTRoomType);
-	
+  OS_ChannelGet(&Tx_UARTChannel);
   return(TXFIFOSUCCESS);
 }
 // number of elements in index FIFO
@@ -89,44 +96,63 @@ rx_UARTDataType volatile *Rx_UARTGetPt; // get next
 rx_UARTDataType static Rx_UARTFifo[RXFIFOSIZE];
 
 Sema4Type Rx_UARTDataAvailable;
+ChannelType Rx_UARTChannel;
 
 // initialize pointer FIFO
 void Rx_UARTFifo_Init(void){ long sr;
   sr = StartCritical();      // make atomic
   OS_InitSemaphore(&Rx_UARTDataAvailable, 0);
+  OS_ChannelInit(&Rx_UARTChannel, "UART Rx", RXFIFOSIZE-1, OS_CHANNEL_REJECT, 0);
   Rx_UARTPutPt = Rx_UARTGetPt = &Rx_UARTFifo[0]; // Empty
   EndCritical(sr);
 }
 // add element to end of pointer FIFO
 // return RXFIFOSUCCESS if successful
-int Rx_UARTFifo_Put(rx_UARTDataType data){
-  rx_UARTDataType volatile *nextPutPt;
-  nextPutPt = Rx_UARTPutPt+1;
-  if(nextPutPt == &Rx_UARTFifo[RXFIFOSIZE]){
-    nextPutPt = &Rx_UARTFifo[0];  // wrap
+int Rx_UARTFifo_Put(rx_UARTDataType data){ long sr;
+  int room;
+  while((room = OS_ChannelReserve(&Rx_UARTChannel)) == OS_CHANNEL_REPLACE){
+    if(OS_WaitTimeout(&Rx_UARTDataAvailable, 0) == 0){
+      room = OS_CHANNEL_FULL;     // reader claimed them all, drop the new one
+      break;
+    }
+    sr = StartCritical();         // discard the oldest character
+    Rx_UARTGetPt++;
+    if(Rx_UARTGetPt == &Rx_UARTFifo[RXFIFOSIZE]){
+      Rx_UARTGetPt = &Rx_UARTFifo[0];
+    }
+    EndCritical(sr);
+    OS_Signal(&Rx_UARTChannel.Room);
   }
-  if(nextPutPt == Rx_UARTGetPt){
+  if(room == OS_CHANNEL_FULL){
     return(RXFIFOFAIL);      // Failed, fifo full
   }
+  *(Rx_UARTPutPt) = data;       // Put, Rx_UARTChannel reserved the room
+  if(Rx_UARTPutPt+1 == &Rx_UARTFifo[RXFIFOSIZE]){
+    Rx_UARTPutPt = &Rx_UARTFifo[0];  // wrap
+  }
   else{
-    *(Rx_UARTPutPt) = data;       // Put
-    Rx_UARTPutPt = nextPutPt;     // Success, update
-	OS_Signal(&Rx_UARTDataAvailable);
-    return(RXFIFOSUCCESS);
+    Rx_UARTPutPt = Rx_UARTPutPt+1;
   }
+  OS_ChannelPut(&Rx_UARTChannel, Rx_UARTFifo_Size());
+  OS_Signal(&Rx_UARTDataAvailable);
+  return(RXFIFOSUCCESS);
 }
 // remove element from front of pointer FIFO
 // return RXFIFOSUCCESS if successful
-int Rx_UARTFifo_Get(rx_UARTDataType *datapt){
+int Rx_UARTFifo_Get(rx_UARTDataType *datapt){ long sr;
 	OS_Wait(&Rx_UARTDataAvailable);
 	
+  sr = StartCritical();      // a drop-oldest put may move Rx_UARTGetPt too
 	if(Rx_UARTPutPt == Rx_UARTGetPt ){
+    EndCritical(sr);
     return(RXFIFOFAIL);      // Empty if PutPt=GetPt
   }
   *datapt = *(Rx_UARTGetPt++);
   if(Rx_UARTGetPt == &Rx_UARTFifo[RXFIFOSIZE]){
      Rx_UARTGetPt = &Rx_UARTFifo[0];   // wrap
   }
+  EndCritical(sr);
+  OS_ChannelGet(&Rx_UARTChannel);
   return(RXFIFOSUCCESS);
 }
 // number of elements in pointer FIFO
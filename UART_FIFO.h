@@ -1,6 +1,8 @@
 #ifndef UART_FIFO_H
 #define UART_FIFO_H
 
+#include "os.h"
+
 long StartCritical (void);    // previous I bit, disable interrupts
 void EndCritical(long sr);    // restore I bit to previous value
 
@@ -31,4 +33,10 @@ int Rx_UARTFifo_Get(rx_UARTDataType *datapt);
 // 0 to RXFIFOSIZE-1
 unsigned short Rx_UARTFifo_Size(void);
 
+// overflow policies and statistics, OS_ChannelPolicy changes the policy
+// transmit blocks the calling thread until there is room
+// receive drops the new character when full
+extern ChannelType Tx_UARTChannel;
+extern ChannelType Rx_UARTChannel;
+
 #endif
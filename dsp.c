@@ -0,0 +1,261 @@
+// dsp.c
+// Runs on LM4F120/TM4C123
+// Fixed-point filters for blocks of ADC samples.
+// Q15 samples, Q15 FIR and Q14 biquad coefficients.
+// The inner loops use SMLAD (two 16x16 multiplies and an
+// accumulate in one cycle), QADD16 (two saturating adds) and
+// SSAT.  Keil defines __TARGET_FEATURE_DSPMUL for the M4,
+// anything else gets the C versions below.
+
+#include <stdint.h>
+#include "dsp.h"
+
+#if defined(__ARMCC_VERSION) && defined(__TARGET_FEATURE_DSPMUL)
+#define SMLAD(x,y,acc) __smlad(x,y,acc)
+#define QADD16(x,y)    __qadd16(x,y)
+#define SSAT16(x)      __ssat(x,16)
+#define READ2(p)       (*(__packed uint32_t *)(p))
+#else
+int32_t static smlad(uint32_t x, uint32_t y, int32_t acc){
+  return acc + (int16_t)x*(int16_t)y + (int16_t)(x>>16)*(int16_t)(y>>16);
+}
+int32_t static ssat16(int32_t x){
+  if(x > 32767) return 32767;
+  if(x < -32768) return -32768;
+  return x;
+}
+uint32_t static qadd16(uint32_t x, uint32_t y){
+  uint32_t lo = (uint16_t)ssat16((int16_t)x + (int16_t)y);
+  uint32_t hi = (uint16_t)ssat16((int16_t)(x>>16) + (int16_t)(y>>16));
+  return lo|(hi<<16);
+}
+#define SMLAD(x,y,acc) smlad(x,y,acc)
+#define QADD16(x,y)    qadd16(x,y)
+#define SSAT16(x)      ssat16(x)
+#define READ2(p)       ((uint16_t)(p)[0]|((uint32_t)(uint16_t)(p)[1]<<16))
+#endif
+
+// ******** DSP_FromADC ************
+// Convert 12-bit ADC samples to signed Q15 around center
+// Input: in 0 to 4095, out Q15, n samples, center ADC value at 0
+// Output: none
+void DSP_FromADC(const uint16_t *in, int16_t *out, uint32_t n, uint16_t center){
+  uint32_t offset = (uint16_t)(-center);
+  uint32_t v;
+  offset = offset|(offset<<16);
+  for(; n>1; n=n-2){
+    v = QADD16(READ2((const int16_t *)in), offset); // two samples minus center
+    v = QADD16(v, v);              // times 16 by doubling, saturating
+    v = QADD16(v, v);
+    v = QADD16(v, v);
+    v = QADD16(v, v);
+    out[0] = (int16_t)v;
+    out[1] = (int16_t)(v>>16);
+    in = in + 2;
+    out = out + 2;
+  }
+  if(n){
+    out[0] = SSAT16(((int32_t)in[0] - center)*16);
+  }
+}
+
+// ******** DSP_FIR_Init ************
+// Input: coefficients in Q15, state of 2*numTaps, numTaps even
+// Output: none
+void DSP_FIR_Init(firType *f, const int16_t *coeff, int16_t *state, uint32_t numTaps){
+  uint32_t i;
+  f->coeff = coeff;
+  f->state = state;
+  f->numTaps = numTaps;
+  f->index = 0;
+  for(i=0; i<2*numTaps; i++){
+    state[i] = 0;
+  }
+}
+
+// newest sample goes below the previous one, and is written twice,
+// so state[index] to state[index+numTaps-1] is newest to oldest
+void static firpush(firType *f, int16_t x){
+  if(f->index == 0){
+    f->index = f->numTaps;
+  }
+  f->index = f->index - 1;
+  f->state[f->index] = x;
+  f->state[f->index + f->numTaps] = x;
+}
+
+// sum of h[k]*x[n-k], two taps per SMLAD, sum |h| must be below 2
+int16_t static firdot(firType *f){
+  const int16_t *h = f->coeff;
+  const int16_t *x = &f->state[f->index];
+  int32_t acc = 0;
+  uint32_t k;
+  for(k=0; k<f->numTaps; k=k+2){
+    acc = SMLAD(READ2(&h[k]), READ2(&x[k]), acc);
+  }
+  return SSAT16(acc>>15);
+}
+
+// ******** DSP_FIR ************
+// Filter n samples, in and out may be the same block
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_FIR(firType *f, const int16_t *in, int16_t *out, uint32_t n){
+  uint32_t i;
+  for(i=0; i<n; i++){
+    firpush(f, in[i]);
+    out[i] = firdot(f);
+  }
+}
+
+// ******** DSP_IIR_Init ************
+// Input: 5 coefficients and 4 state entries per stage
+// Output: none
+void DSP_IIR_Init(iirType *f, const int16_t *coeff, int16_t *state, uint32_t numStages){
+  uint32_t i;
+  f->coeff = coeff;
+  f->state = state;
+  f->numStages = numStages;
+  for(i=0; i<4*numStages; i++){
+    state[i] = 0;
+  }
+}
+
+// ******** DSP_IIR ************
+// Filter n samples, in and out may be the same block
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_IIR(iirType *f, const int16_t *in, int16_t *out, uint32_t n){
+  const int16_t *c = f->coeff;
+  int16_t *s = f->state;
+  uint32_t stage, i;
+  for(stage=0; stage<f->numStages; stage++){
+    int32_t b0 = c[0];
+    uint32_t b12 = READ2(&c[1]);   // b1 b2
+    uint32_t a12 = READ2(&c[3]);   // a1 a2
+    uint32_t xs = READ2(&s[0]);    // x1 x2
+    uint32_t ys = READ2(&s[2]);    // y1 y2
+    for(i=0; i<n; i++){
+      int32_t x = in[i];
+      int32_t acc = b0*x;
+      acc = SMLAD(xs, b12, acc);
+      acc = SMLAD(ys, a12, acc);
+      acc = SSAT16(acc>>14);
+      xs = (uint16_t)x|(xs<<16);   // x2 = x1, x1 = x
+      ys = (uint16_t)acc|(ys<<16); // y2 = y1, y1 = y
+      out[i] = acc;
+    }
+    s[0] = (int16_t)xs; s[1] = (int16_t)(xs>>16);
+    s[2] = (int16_t)ys; s[3] = (int16_t)(ys>>16);
+    in = out;                      // later stages filter in place
+    c = c + 5;
+    s = s + 4;
+  }
+}
+
+// ******** DSP_Average_Init ************
+// Input: buffer of size entries, size at least 1
+// Output: none
+void DSP_Average_Init(averageType *f, int16_t *buf, uint32_t size){
+  uint32_t i;
+  f->buf = buf;
+  f->size = size;
+  f->index = 0;
+  f->sum = 0;
+  for(i=0; i<size; i++){
+    buf[i] = 0;
+  }
+}
+
+// ******** DSP_Average ************
+// Each output is the mean of the last size inputs
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_Average(averageType *f, const int16_t *in, int16_t *out, uint32_t n){
+  uint32_t i;
+  for(i=0; i<n; i++){
+    f->sum = f->sum + in[i] - f->buf[f->index];
+    f->buf[f->index] = in[i];
+    f->index++;
+    if(f->index == f->size){
+      f->index = 0;
+    }
+    out[i] = f->sum/(int32_t)f->size;
+  }
+}
+
+// ******** DSP_Median_Init ************
+// Input: window size, odd, 1 to DSP_MAXMEDIAN
+// Output: none
+void DSP_Median_Init(medianType *f, uint32_t size){
+  uint32_t i;
+  if(size > DSP_MAXMEDIAN){
+    size = DSP_MAXMEDIAN;
+  }
+  f->size = size;
+  f->index = 0;
+  for(i=0; i<size; i++){
+    f->ring[i] = 0;
+    f->sorted[i] = 0;
+  }
+}
+
+// ******** DSP_Median ************
+// Each output is the median of the last size inputs
+// the sorted copy is updated in place, O(size) per sample
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_Median(medianType *f, const int16_t *in, int16_t *out, uint32_t n){
+  uint32_t i, j;
+  for(i=0; i<n; i++){
+    int16_t old = f->ring[f->index];
+    int16_t x = in[i];
+    f->ring[f->index] = x;
+    f->index++;
+    if(f->index == f->size){
+      f->index = 0;
+    }
+    j = 0;                         // find the oldest sample
+    while(f->sorted[j] != old){
+      j++;
+    }
+    while((j > 0) && (f->sorted[j-1] > x)){ // slide larger ones up
+      f->sorted[j] = f->sorted[j-1];
+      j--;
+    }
+    while((j < f->size-1) && (f->sorted[j+1] < x)){ // or smaller ones down
+      f->sorted[j] = f->sorted[j+1];
+      j++;
+    }
+    f->sorted[j] = x;
+    out[i] = f->sorted[f->size/2];
+  }
+}
+
+// ******** DSP_Decimate_Init ************
+// Input: anti-alias FIR as in DSP_FIR_Init, keep 1 of factor
+// Output: none
+void DSP_Decimate_Init(decimateType *f, const int16_t *coeff, int16_t *state,
+  uint32_t numTaps, uint32_t factor){
+  DSP_FIR_Init(&f->fir, coeff, state, numTaps);
+  f->factor = factor;
+  f->phase = 0;
+}
+
+// ******** DSP_Decimate ************
+// Low pass and down-sample, only kept outputs are computed
+// Input: in Q15, n samples, out has room for n/factor+1
+// Output: number of samples written to out
+uint32_t DSP_Decimate(decimateType *f, const int16_t *in, int16_t *out, uint32_t n){
+  uint32_t i, count = 0;
+  for(i=0; i<n; i++){
+    firpush(&f->fir, in[i]);
+    f->phase++;
+    if(f->phase == f->factor){
+      f->phase = 0;
+      out[count] = firdot(&f->fir);
+      count++;
+    }
+  }
+  return count;
+}
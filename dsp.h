@@ -0,0 +1,126 @@
+// dsp.h
+// Runs on LM4F120/TM4C123
+// Fixed-point filters for blocks of ADC samples.
+// Samples are Q15 (int16_t, -32768 to 32767 is -1 to +1).
+// On the Cortex-M4 the kernels use the SIMD and MAC
+// instructions (SMLAD, QADD16, SSAT); other compilers get
+// plain C that computes the same results.
+// Every filter keeps its own state, so one filter per
+// stream, and each call handles a block of n samples.
+
+#ifndef __DSP_H__
+#define __DSP_H__
+
+#include <stdint.h>
+
+// FIR filter, numTaps must be even
+// state needs 2*numTaps entries so every window is contiguous
+struct fir {
+  const int16_t *coeff;   // h[0] to h[numTaps-1], Q15
+  int16_t *state;         // delay line, twice numTaps long
+  uint32_t numTaps;
+  uint32_t index;         // where the next sample goes
+};
+typedef struct fir firType;
+
+// cascade of biquads, direct form I
+// coeff has b0 b1 b2 a1 a2 per stage in Q14, where
+// y = b0*x + b1*x1 + b2*x2 + a1*y1 + a2*y2 (a1 a2 already negated)
+// state needs 4 entries per stage: x1 x2 y1 y2
+struct iir {
+  const int16_t *coeff;
+  int16_t *state;
+  uint32_t numStages;
+};
+typedef struct iir iirType;
+
+// running mean of the last size samples
+struct average {
+  int16_t *buf;           // size entries
+  uint32_t size;
+  uint32_t index;
+  int32_t sum;
+};
+typedef struct average averageType;
+
+// median of the last size samples, size odd and at most DSP_MAXMEDIAN
+#define DSP_MAXMEDIAN 9
+struct median {
+  int16_t ring[DSP_MAXMEDIAN];   // in arrival order
+  int16_t sorted[DSP_MAXMEDIAN]; // same samples, ascending
+  uint32_t size;
+  uint32_t index;
+};
+typedef struct median medianType;
+
+// FIR low pass followed by keeping one of every factor outputs
+struct decimate {
+  firType fir;
+  uint32_t factor;
+  uint32_t phase;         // samples since the last output
+};
+typedef struct decimate decimateType;
+
+// ******** DSP_FromADC ************
+// Convert 12-bit ADC samples to signed Q15 around center
+// Input: in 0 to 4095, out Q15, n samples, center ADC value at 0
+// Output: none
+void DSP_FromADC(const uint16_t *in, int16_t *out, uint32_t n, uint16_t center);
+
+// ******** DSP_FIR_Init ************
+// Input: coefficients in Q15, state of 2*numTaps, numTaps even
+// Output: none
+void DSP_FIR_Init(firType *f, const int16_t *coeff, int16_t *state, uint32_t numTaps);
+
+// ******** DSP_FIR ************
+// Filter n samples, in and out may be the same block
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_FIR(firType *f, const int16_t *in, int16_t *out, uint32_t n);
+
+// ******** DSP_IIR_Init ************
+// Input: 5 coefficients and 4 state entries per stage
+// Output: none
+void DSP_IIR_Init(iirType *f, const int16_t *coeff, int16_t *state, uint32_t numStages);
+
+// ******** DSP_IIR ************
+// Filter n samples, in and out may be the same block
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_IIR(iirType *f, const int16_t *in, int16_t *out, uint32_t n);
+
+// ******** DSP_Average_Init ************
+// Input: buffer of size entries, size at least 1
+// Output: none
+void DSP_Average_Init(averageType *f, int16_t *buf, uint32_t size);
+
+// ******** DSP_Average ************
+// Each output is the mean of the last size inputs
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_Average(averageType *f, const int16_t *in, int16_t *out, uint32_t n);
+
+// ******** DSP_Median_Init ************
+// Input: window size, odd, 1 to DSP_MAXMEDIAN
+// Output: none
+void DSP_Median_Init(medianType *f, uint32_t size);
+
+// ******** DSP_Median ************
+// Each output is the median of the last size inputs
+// Input: in, out Q15, n samples
+// Output: none
+void DSP_Median(medianType *f, const int16_t *in, int16_t *out, uint32_t n);
+
+// ******** DSP_Decimate_Init ************
+// Input: anti-alias FIR as in DSP_FIR_Init, keep 1 of factor
+// Output: none
+void DSP_Decimate_Init(decimateType *f, const int16_t *coeff, int16_t *state,
+  uint32_t numTaps, uint32_t factor);
+
+// ******** DSP_Decimate ************
+// Low pass and down-sample, only kept outputs are computed
+// Input: in Q15, n samples, out has room for n/factor+1
+// Output: number of samples written to out
+uint32_t DSP_Decimate(decimateType *f, const int16_t *in, int16_t *out, uint32_t n);
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include "joystick.h"
+#include "os.h"
 #include "tm4c123gh6pm.h"
 
 void DisableInterrupts(void); // Disable interrupts
@@ -81,3 +82,295 @@ void BSP_Joystick_Input(uint16_t *x, uint16_t *y, uint8_t *select){
   *select = SELECT;                // return 0(pressed) or 0x10(not pressed)
   ADC0_ISC_R = 0x0002;             // 4) acknowledge completion
 }
+
+// ------------BSP_Joystick_Average------------
+// Turn on the ADC hardware averager, every result
+// becomes the mean of 2^log2count conversions.
+// ADC0_SAC_R is shared by all sequencers, so the
+// microphone and accelerometer streams are averaged
+// too and their highest rate drops by the same factor.
+// Input: log2count 0 (off) to 6 (64 conversions)
+// Output: none
+// Assumes: BSP_Joystick_Init() has been called
+void BSP_Joystick_Average(uint32_t log2count){
+  if(log2count > 6){
+    log2count = 6;
+  }
+  ADC0_SAC_R = log2count;
+}
+
+// ------------BSP_Joystick_Collect------------
+// Sample the joystick periodically without software
+// in the loop.  Timer0A triggers sample sequencer 1
+// directly, so the sampling instant has no jitter, and
+// the SS1 completion interrupt passes the result to task.
+// The ISR never waits for the conversion.
+// Input: period in bus cycles (12.5ns)
+//        priority of the SS1 interrupt, 0 is highest, 7 is lowest
+//        task called from the ISR with X, Y (0 to 4095) and
+//        Select (0 if pressed), it must run to completion
+// Output: none
+// Assumes: BSP_Joystick_Init() has been called
+// BSP_Joystick_Input() can not be used afterwards
+void (*JoystickTask)(uint16_t x, uint16_t y, uint8_t select);
+void BSP_Joystick_Collect(uint32_t period, uint32_t priority,
+  void(*task)(uint16_t x, uint16_t y, uint8_t select)){
+  long sr;
+  sr = StartCritical();
+  JoystickTask = task;
+  SYSCTL_RCGCTIMER_R |= 0x01;      // 1) activate Timer0
+  while((SYSCTL_PRTIMER_R&0x01) == 0){};// allow time for clock to stabilize
+  TIMER0_CTL_R &= ~TIMER_CTL_TAEN; // 2) disable Timer0A during setup
+  TIMER0_CFG_R = TIMER_CFG_32_BIT_TIMER;// 3) 32-bit timer mode
+  TIMER0_TAMR_R = TIMER_TAMR_TAMR_PERIOD;// 4) periodic, down-count
+  TIMER0_TAILR_R = period - 1;     // 5) reload value
+  TIMER0_TAPR_R = 0;
+  TIMER0_IMR_R = 0;                // 6) no timer interrupt, ADC does the work
+  TIMER0_CTL_R |= TIMER_CTL_TAOTE; // 7) time-out triggers the ADC
+  ADC0_ACTSS_R &= ~0x0002;         // 8) disable sample sequencer 1
+  ADC0_EMUX_R = (ADC0_EMUX_R&~ADC_EMUX_EM1_M)|ADC_EMUX_EM1_TIMER;// 9) seq1 is timer trigger
+  ADC0_ISC_R = 0x0002;             // 10) clear any stale completion
+  ADC0_IM_R |= 0x0002;             // 11) enable SS1 interrupts
+  ADC0_ACTSS_R |= 0x0002;          // 12) enable sample sequencer 1
+                                   // 13) priority shifted to bits 31-29 for SS1 (interrupt 15)
+  NVIC_PRI3_R = (NVIC_PRI3_R&0x1FFFFFFF)|(priority << 29);
+  NVIC_EN0_R = 1<<15;              // 14) enable interrupt 15 in NVIC
+  TIMER0_CTL_R |= TIMER_CTL_TAEN;  // 15) enable Timer0A
+  EndCritical(sr);
+}
+
+// SS1 completion, started by Timer0A
+void ADC0Seq1_Handler(void){
+  uint16_t x, y;
+  ADC0_ISC_R = 0x0002;             // acknowledge completion
+  x = ADC0_SSFIFO1_R;              // first result
+  y = ADC0_SSFIFO1_R;              // second result
+  (*JoystickTask)(x, y, SELECT);
+}
+
+//******** Streaming acquisition *****************
+// The microphone (SS3) and accelerometer (SS2) are sampled at kHz
+// rates with no software per sample.  A PWM0 generator triggers
+// each sequencer, and the uDMA controller moves every result into
+// one of two buffers (ping-pong).  The ADC interrupt only runs
+// when a whole block is full: it re-arms that half and signals the
+// consumer, which reads the samples in place.  Timer0A already
+// triggers SS1, so the timer trigger can not be shared here.
+// ADC0 SS2 is uDMA channel 16, SS3 is channel 17 (encoding 0).
+#define MICCH    17
+#define ACCELCH  16
+#define PWMCLOCK 1250000          // 80 MHz/64, PWM counter rate
+
+// channel control table, primary structures in the first 512 bytes,
+// alternate in the second 512, each entry is
+// source end, destination end, control word, unused
+__align(1024) uint32_t DMAControlTable[256];
+
+struct stream {
+  uint32_t channel;               // uDMA channel number
+  volatile uint32_t *fifo;        // ADC sequencer FIFO, source
+  uint32_t control;               // control word to re-arm a half
+  uint16_t *buf[2];               // ping-pong halves
+  uint16_t *ReadyPt;              // most recently filled half
+  uint32_t Busy;                  // 1 while consumer holds a block
+  Sema4Type BlockReady;           // signaled once per filled block
+  unsigned long Blocks;           // blocks filled
+  unsigned long Overruns;         // half refilled while still held
+  unsigned long Interrupts;       // ISR runs, should equal Blocks
+};
+typedef struct stream streamType;
+
+uint16_t MicBuf[2][MIC_BLOCKSIZE];
+uint16_t AccelBuf[2][ACCEL_BLOCKSIZE*3];
+streamType MicStream, AccelStream;
+
+void static dmainit(void){
+  if(SYSCTL_RCGCDMA_R&0x01){
+    return;                        // already running
+  }
+  SYSCTL_RCGCDMA_R |= 0x01;        // activate uDMA
+  while((SYSCTL_PRDMA_R&0x01) == 0){};
+  UDMA_CFG_R = 0x01;               // master enable
+  UDMA_CTLBASE_R = (uint32_t)DMAControlTable;
+}
+
+// set up one ping-pong channel, count 16-bit results per half
+void static streaminit(streamType *s, uint32_t channel, volatile uint32_t *fifo,
+  uint16_t *buf0, uint16_t *buf1, uint32_t count){
+  uint32_t bit = 1<<channel;
+  s->channel = channel;
+  s->fifo = fifo;
+  s->buf[0] = buf0;
+  s->buf[1] = buf1;
+  s->ReadyPt = buf0;
+  s->Busy = 0;
+  s->Blocks = 0;
+  s->Overruns = 0;
+  s->Interrupts = 0;
+  OS_InitSemaphore(&s->BlockReady, 0);
+  s->control = UDMA_CHCTL_DSTINC_16|UDMA_CHCTL_DSTSIZE_16|
+               UDMA_CHCTL_SRCINC_NONE|UDMA_CHCTL_SRCSIZE_16|
+               UDMA_CHCTL_ARBSIZE_1|((count-1)<<4)|UDMA_CHCTL_XFERMODE_PINGPONG;
+  dmainit();
+  UDMA_ENACLR_R = bit;             // disable channel during setup
+  UDMA_CHMAP2_R &= ~(0xF<<((channel-16)*4));// encoding 0 is ADC0
+  UDMA_PRIOCLR_R = bit;            // default priority
+  UDMA_ALTCLR_R = bit;             // start with primary
+  UDMA_USEBURSTCLR_R = bit;        // respond to single requests
+  UDMA_REQMASKCLR_R = bit;         // allow the ADC to request
+  DMAControlTable[channel*4] = (uint32_t)fifo;
+  DMAControlTable[channel*4+1] = (uint32_t)&buf0[count-1];
+  DMAControlTable[channel*4+2] = s->control;
+  DMAControlTable[128+channel*4] = (uint32_t)fifo;
+  DMAControlTable[128+channel*4+1] = (uint32_t)&buf1[count-1];
+  DMAControlTable[128+channel*4+2] = s->control;
+  UDMA_ENASET_R = bit;             // enable channel
+}
+
+// PWM0 generator gen counts at PWMCLOCK and triggers the ADC at rate
+void static pwmtrigger(uint32_t gen, uint32_t rate){
+  volatile uint32_t *ctl = &PWM0_0_CTL_R + gen*0x10;// generators are 0x40 apart
+  SYSCTL_RCGCPWM_R |= 0x01;        // activate PWM0
+  while((SYSCTL_PRPWM_R&0x01) == 0){};
+  SYSCTL_RCC_R = (SYSCTL_RCC_R&~SYSCTL_RCC_PWMDIV_M)|
+                 SYSCTL_RCC_USEPWMDIV|SYSCTL_RCC_PWMDIV_64;
+  ctl[0] = 0;                      // CTL: disable, count down
+  ctl[1] = PWM_0_INTEN_TRCNTLOAD;  // INTEN: ADC trigger on load, no interrupt
+  ctl[4] = PWMCLOCK/rate - 1;      // LOAD
+  ctl[0] = 0x01;                   // enable generator
+}
+
+// called when uDMA finishes a half, re-arm whichever half stopped
+void static streamdone(streamType *s){
+  uint32_t *pri = &DMAControlTable[s->channel*4];
+  uint32_t *alt = &DMAControlTable[128+s->channel*4];
+  int i;
+  s->Interrupts++;
+  for(i=0; i<2; i++){
+    uint32_t *half = i ? alt : pri;
+    if((half[2]&UDMA_CHCTL_XFERMODE_M) == UDMA_CHCTL_XFERMODE_STOP){
+      half[2] = s->control;        // refill this half after the other
+      if(s->Busy){
+        s->Overruns++;             // consumer still reading, too slow
+      }
+      s->ReadyPt = s->buf[i];
+      s->Blocks++;
+      OS_bSignal(&s->BlockReady);
+    }
+  }
+}
+
+// ------------BSP_Microphone_Stream------------
+// Sample the microphone continuously into ping-pong
+// blocks of MIC_BLOCKSIZE samples using uDMA.
+// Input: rate sampling rate in Hz (20 to 125000)
+//        priority of the block interrupt, 0 is highest, 7 is lowest
+// Output: none
+void BSP_Microphone_Stream(uint32_t rate, uint32_t priority){
+  long sr;
+  sr = StartCritical();
+  SYSCTL_RCGCGPIO_R |= 0x00000010; // 1) activate clock for Port E
+  while((SYSCTL_PRGPIO_R&0x10) == 0){};
+  GPIO_PORTE_DIR_R &= ~0x20;       // 2) make PE5 input
+  GPIO_PORTE_AFSEL_R |= 0x20;      // 3) enable alt funct on PE5
+  GPIO_PORTE_DEN_R &= ~0x20;       // 4) disable digital I/O on PE5
+  GPIO_PORTE_AMSEL_R |= 0x20;      // 5) enable analog on PE5
+  adcinit();                       // 6) general ADC initialization
+  ADC0_ACTSS_R &= ~0x0008;         // 7) disable sample sequencer 3
+  ADC0_EMUX_R = (ADC0_EMUX_R&~ADC_EMUX_EM3_M)|ADC_EMUX_EM3_PWM0;// 8) PWM0 gen 0 trigger
+  ADC0_SSMUX3_R = 8;               // 9) AIN8
+  ADC0_SSCTL3_R = 0x0006;          // 10) IE0 END0, IE requests uDMA
+  streaminit(&MicStream, MICCH, &ADC0_SSFIFO3_R, MicBuf[0], MicBuf[1], MIC_BLOCKSIZE);
+  UDMA_CHIS_R = 1<<MICCH;          // 11) clear any stale block done
+  ADC0_IM_R &= ~0x0008;            // 12) no interrupt per sample, uDMA block done uses the SS3 vector
+  ADC0_ACTSS_R |= 0x0008;          // 13) enable sample sequencer 3
+                                   // 14) priority shifted to bits 15-13 for SS3 (interrupt 17)
+  NVIC_PRI4_R = (NVIC_PRI4_R&0xFFFF1FFF)|(priority << 13);
+  NVIC_EN0_R = 1<<17;              // 15) enable interrupt 17 in NVIC
+  pwmtrigger(0, rate);             // 16) start sampling
+  EndCritical(sr);
+}
+
+// ------------BSP_Microphone_GetBlock------------
+// Wait for the next filled microphone block.  The data
+// are not copied; the pointer stays valid until
+// BSP_Microphone_ReleaseBlock, which must be called
+// within one block time or the half is overwritten.
+// Input: none
+// Output: pointer to MIC_BLOCKSIZE 12-bit samples
+uint16_t *BSP_Microphone_GetBlock(void){
+  OS_bWait(&MicStream.BlockReady);
+  MicStream.Busy = 1;
+  return MicStream.ReadyPt;
+}
+
+// ------------BSP_Microphone_ReleaseBlock------------
+// Done with the block from BSP_Microphone_GetBlock.
+// Input: none
+// Output: none
+void BSP_Microphone_ReleaseBlock(void){
+  MicStream.Busy = 0;
+}
+
+// SS3 uDMA block complete
+void ADC0Seq3_Handler(void){
+  UDMA_CHIS_R = 1<<MICCH;          // acknowledge the uDMA block done
+  streamdone(&MicStream);
+}
+
+// ------------BSP_Accelerometer_Stream------------
+// Sample the accelerometer X, Y and Z continuously into
+// ping-pong blocks of ACCEL_BLOCKSIZE triples using uDMA.
+// Input: rate sampling rate of each axis in Hz (20 to 40000)
+//        priority of the block interrupt, 0 is highest, 7 is lowest
+// Output: none
+void BSP_Accelerometer_Stream(uint32_t rate, uint32_t priority){
+  long sr;
+  sr = StartCritical();
+  SYSCTL_RCGCGPIO_R |= 0x00000008; // 1) activate clock for Port D
+  while((SYSCTL_PRGPIO_R&0x08) == 0){};
+  GPIO_PORTD_DIR_R &= ~0x07;       // 2) make PD2-0 input
+  GPIO_PORTD_AFSEL_R |= 0x07;      // 3) enable alt funct on PD2-0
+  GPIO_PORTD_DEN_R &= ~0x07;       // 4) disable digital I/O on PD2-0
+  GPIO_PORTD_AMSEL_R |= 0x07;      // 5) enable analog on PD2-0
+  adcinit();                       // 6) general ADC initialization
+  ADC0_ACTSS_R &= ~0x0004;         // 7) disable sample sequencer 2
+  ADC0_EMUX_R = (ADC0_EMUX_R&~ADC_EMUX_EM2_M)|ADC_EMUX_EM2_PWM1;// 8) PWM0 gen 1 trigger
+  ADC0_SSMUX2_R = 0x0567;          // 9) AIN7 (X), AIN6 (Y), AIN5 (Z)
+  ADC0_SSCTL2_R = 0x0644;          // 10) IE0 IE1 IE2 END2, each IE requests one uDMA transfer
+  streaminit(&AccelStream, ACCELCH, &ADC0_SSFIFO2_R, AccelBuf[0], AccelBuf[1], ACCEL_BLOCKSIZE*3);
+  UDMA_CHIS_R = 1<<ACCELCH;        // 11) clear any stale block done
+  ADC0_IM_R &= ~0x0004;            // 12) no interrupt per sample, uDMA block done uses the SS2 vector
+  ADC0_ACTSS_R |= 0x0004;          // 13) enable sample sequencer 2
+                                   // 14) priority shifted to bits 7-5 for SS2 (interrupt 16)
+  NVIC_PRI4_R = (NVIC_PRI4_R&0xFFFFFF1F)|(priority << 5);
+  NVIC_EN0_R = 1<<16;              // 15) enable interrupt 16 in NVIC
+  pwmtrigger(1, rate);             // 16) start sampling
+  EndCritical(sr);
+}
+
+// ------------BSP_Accelerometer_GetBlock------------
+// Wait for the next filled accelerometer block, no copy.
+// Samples are interleaved X, Y, Z.  The pointer stays
+// valid until BSP_Accelerometer_ReleaseBlock.
+// Input: none
+// Output: pointer to ACCEL_BLOCKSIZE*3 12-bit samples
+uint16_t *BSP_Accelerometer_GetBlock(void){
+  OS_bWait(&AccelStream.BlockReady);
+  AccelStream.Busy = 1;
+  return AccelStream.ReadyPt;
+}
+
+// ------------BSP_Accelerometer_ReleaseBlock------------
+// Done with the block from BSP_Accelerometer_GetBlock.
+// Input: none
+// Output: none
+void BSP_Accelerometer_ReleaseBlock(void){
+  AccelStream.Busy = 0;
+}
+
+// SS2 uDMA block complete
+void ADC0Seq2_Handler(void){
+  UDMA_CHIS_R = 1<<ACCELCH;        // acknowledge the uDMA block done
+  streamdone(&AccelStream);
+}
@@ -19,3 +19,78 @@ void BSP_Joystick_Init(void);
 // Output: none
 // Assumes: BSP_Joystick_Init() has been called
 void BSP_Joystick_Input(uint16_t *x, uint16_t *y, uint8_t *select);
+
+// ------------BSP_Joystick_Average------------
+// Turn on the ADC hardware averager, every result
+// becomes the mean of 2^log2count conversions.
+// Applies to every ADC0 sequencer, including the streams.
+// Input: log2count 0 (off) to 6 (64 conversions)
+// Output: none
+// Assumes: BSP_Joystick_Init() has been called
+void BSP_Joystick_Average(uint32_t log2count);
+
+// ------------BSP_Joystick_Collect------------
+// Sample the joystick periodically without software
+// in the loop.  Timer0A triggers sample sequencer 1
+// directly, so the sampling instant has no jitter, and
+// the SS1 completion interrupt passes the result to task.
+// Input: period in bus cycles (12.5ns)
+//        priority of the SS1 interrupt, 0 is highest, 7 is lowest
+//        task called from the ISR with X, Y (0 to 4095) and
+//        Select (0 if pressed), it must run to completion
+// Output: none
+// Assumes: BSP_Joystick_Init() has been called
+// BSP_Joystick_Input() can not be used afterwards
+void BSP_Joystick_Collect(uint32_t period, uint32_t priority,
+  void(*task)(uint16_t x, uint16_t y, uint8_t select));
+
+#define MIC_BLOCKSIZE   256    // samples per microphone block
+#define ACCEL_BLOCKSIZE 64     // X,Y,Z triples per accelerometer block
+
+// ------------BSP_Microphone_Stream------------
+// Sample the microphone continuously into ping-pong
+// blocks of MIC_BLOCKSIZE samples using uDMA.
+// PWM0 generator 0 triggers sample sequencer 3, and
+// the CPU only runs once per filled block.
+// Input: rate sampling rate in Hz (20 to 125000)
+//        priority of the block interrupt, 0 is highest, 7 is lowest
+// Output: none
+void BSP_Microphone_Stream(uint32_t rate, uint32_t priority);
+
+// ------------BSP_Microphone_GetBlock------------
+// Wait for the next filled microphone block.  The data
+// are not copied; the pointer stays valid until
+// BSP_Microphone_ReleaseBlock, which must be called
+// within one block time or the half is overwritten.
+// Input: none
+// Output: pointer to MIC_BLOCKSIZE 12-bit samples
+uint16_t *BSP_Microphone_GetBlock(void);
+
+// ------------BSP_Microphone_ReleaseBlock------------
+// Done with the block from BSP_Microphone_GetBlock.
+// Input: none
+// Output: none
+void BSP_Microphone_ReleaseBlock(void);
+
+// ------------BSP_Accelerometer_Stream------------
+// Sample the accelerometer X, Y and Z continuously into
+// ping-pong blocks of ACCEL_BLOCKSIZE triples using uDMA.
+// PWM0 generator 1 triggers sample sequencer 2.
+// Input: rate sampling rate of each axis in Hz (20 to 40000)
+//        priority of the block interrupt, 0 is highest, 7 is lowest
+// Output: none
+void BSP_Accelerometer_Stream(uint32_t rate, uint32_t priority);
+
+// ------------BSP_Accelerometer_GetBlock------------
+// Wait for the next filled accelerometer block, no copy.
+// Samples are interleaved X, Y, Z.  The pointer stays
+// valid until BSP_Accelerometer_ReleaseBlock.
+// Input: none
+// Output: pointer to ACCEL_BLOCKSIZE*3 12-bit samples
+uint16_t *BSP_Accelerometer_GetBlock(void);
+
+// ------------BSP_Accelerometer_ReleaseBlock------------
+// Done with the block from BSP_Accelerometer_GetBlock.
+// Input: none
+// Output: none
+void BSP_Accelerometer_ReleaseBlock(void);
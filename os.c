@@ -37,10 +37,27 @@ long StartCritical(void);    			// previous I bit, disable interrupts
 void EndCritical(long sr);    		// restore I bit to previous value
 void WaitForInterrupt(void);  		// low power mode
 void StartOS(void);
+int OS_TryDecrement(Sema4Type *semaPt); // LDREX/STREX semaphore fast paths
+int OS_TryIncrement(Sema4Type *semaPt);
+int OS_TrySet(Sema4Type *semaPt);
 
-// Periodic task function pointers
-void (*PeriodicTask1)(void);
-void (*PeriodicTask2)(void);
+// osasm.s links against the one that matches its own OS_RAMFUNC
+#if OS_RAMFUNC
+const long OS_RamfuncOn = 1;
+#else
+const long OS_RamfuncOff = 1;
+#endif
+
+// Periodic loads, see OS_AddPeriodicThreadWCET
+#define MAXPERIODIC  8          // entries in the analysis
+#define NUMPERIODICTIMERS 2     // Timer1A and Timer4A
+#define TICKWCET (TIME_1MS/20)  // 50us, Timer2A_Handler waking a full timeout queue
+
+periodicType Periodic[MAXPERIODIC];
+unsigned long NumPeriodic;
+periodicType *PeriodicTimer[NUMPERIODICTIMERS]; // entry run by Timer1A, Timer4A
+unsigned long NumPeriodicTimers;
+int TickLoad;                   // entry of Timer2A_Handler
 
 // Button task function pointers
 void (*ButtonOneTask)(void);
@@ -48,20 +65,92 @@ void (*ButtonTwoTask)(void);
 
 #define NUMTHREADS	20					// Maximum number of threads
 #define STACKSIZE		100      		// Number of 32-bit words in stack
+#define STACKPAINT	0xA5A5A5A5	// Unused stack words, for the high water
+
+// Thread states
+#define FREE        0   // tcb is available
+#define READY       1   // in the ring of threads that can run
+#define BLOCKED     2   // waiting on a semaphore, possibly with a timeout
+#define SLEEPING    3   // waiting in the timeout queue only
+#define THROTTLED   4   // ready, but its server has no budget left
+
+#define NUMPRI      8   // thread priorities, 0 is the highest
+#define IDLEPRI     (NUMPRI-1)  // only the idle thread runs at the lowest
+
+#define MAXWAITANY  4   // Maximum number of semaphores in one OS_WaitAny
+
+typedef struct wait waitType;  // semaphore waiter, see os.h
 
 // TCB Data Structure
 struct tcb {
   int32_t *sp;           // Pointer to stack (valid for threads not running
-  struct tcb *next;      // Linked list pointer
+  struct tcb *next;      // Linked list pointer, next tcb in ring or free list
+  struct tcb *prev;      // Linked list pointer, previous tcb in ring
   uint32_t id;           // Thread #
-  uint32_t available;    // Used to indicate if this tcb is available or not
-	uint32_t sleepCt;	     // Sleep counter in MS
+  uint32_t state;        // FREE, READY, BLOCKED or SLEEPING
+  uint32_t priority;     // 0 is the highest, IDLEPRI for the idle thread
+  uint32_t threshold;    // while running, only priorities above this preempt it
+  uint32_t switches;     // times it was switched to
+  ServerType *server;    // budget it runs on, 0 if none
+  struct tcb *snext;     // Linked list pointer, next thread throttled by the same server
+  uint32_t cpu;          // time run, 12.5ns units below 1ms
+  uint32_t cpuMs;        // time run, ms
+  uint32_t edf;          // 1 for a deadline thread ordered by EDF
+  uint32_t heapIndex;    // place in EdfHeap while ready
+  uint32_t period;       // ms between releases of a deadline thread, 0 for others
+  uint32_t relDeadline;  // ms from release to deadline
+  uint32_t release;      // kernel ms of the current release
+  uint32_t deadline;     // kernel ms of the current deadline
+  uint32_t jobs;         // periods completed
+  uint32_t misses;       // periods completed after their deadline
+  uint32_t tickets;      // share of the CPU at OS_SHAREPRI, 0 for other threads
+  uint32_t stride;       // OS_STRIDE1/tickets, pass added per us run
+  uint32_t pass;         // the ready share thread with the lowest pass runs next,
+                         // while not ready its distance from SharePass
+  struct tcb *tnext;     // Linked list pointer, next tcb in timeout queue
+  struct tcb *tprev;     // Linked list pointer, previous tcb in timeout queue
+  uint32_t wakeTime;     // Kernel tick at which the timeout queue releases this thread
+  uint32_t timed;        // 1 while in the timeout queue
+  uint32_t waitStatus;   // 1 + index of the semaphore that was signaled, 0 if the wait timed out
+  waitType *waits;       // Entries in the semaphores' lists of waiters
+  uint32_t numWaits;     // Number of entries, 0 if not waiting
+  waitType wait;         // Entry used by a wait on a single semaphore
+  EventGroupType *groupPt; // Event group waited on, 0 if none
+  struct tcb *fnext;     // Linked list pointer, next thread waiting on the same group
+  uint32_t flagMask;     // Flags waited for
+  uint32_t flagOptions;  // OS_FLAG_ANY or OS_FLAG_ALL, plus OS_FLAG_CLEAR
 };
 typedef struct tcb tcbType;
 
 tcbType *RunPt;														// Pointer to the currently running TCB
 tcbType tcbs[NUMTHREADS]; 								// Statically allocated memory for TCBs
 int32_t Stacks[NUMTHREADS][STACKSIZE];		// Statically allocated memory for Stacks
+tcbType *FreePt;													// Singly linked list of available TCBs
+tcbType *KilledPt;												// Killed TCB, released by Scheduler after the switch
+tcbType *IdlePt;													// Runs only when no other thread is ready
+tcbType *ReadyPt[NUMPRI];									// Ring of ready threads at each priority, next to run
+tcbType *EdfHeap[NUMTHREADS];							// Ready deadline threads, a min heap by deadline
+uint32_t EdfNum;													// Threads in EdfHeap
+uint32_t SharePass;												// Pass of the last share thread picked, the virtual time
+uint32_t Preempting;											// Switch pended because a higher priority thread woke
+uint32_t Yielding;												// Switch pended by OS_Suspend
+unsigned long ContextSwitches;						// Scheduler chose a different thread
+unsigned long Preemptions;								// of them, because a higher priority thread woke
+unsigned long HeldOff;										// Wakes that a preemption threshold kept from preempting
+unsigned long SwitchTime;									// OS_Time when RunPt started running
+tcbType *TimeoutPt;												// Sleeping and timed waits, sorted by wakeTime
+static uint32_t TickCount;								// Kernel ticks (ms) since OS_Init, never cleared
+
+// Longest time interrupts were masked inside OS_AddThread and OS_Kill, in 12.5ns units
+unsigned long MaxAddThreadCritical;
+unsigned long MaxKillCritical;
+
+// Runs when every other thread is blocked or sleeping
+void static IdleThread(void){
+	for(;;){
+		WaitForInterrupt();
+	}
+}
 
 // ******** OS_Init ************
 // initialize operating system, disable interrupts until OS_Launch
@@ -72,9 +161,25 @@ void OS_Init(void){int i;
   OS_DisableInterrupts();
   PLL_Init(Bus80MHz);                 // set processor clock to 80 MHz
 	for(i = 0; i < NUMTHREADS; i++){
-		tcbs[i].available = 1; // initial available
+		tcbs[i].state = FREE;  // initial available
+		tcbs[i].next = &tcbs[i+1]; // chain into the free list
 	}  
-	InitTimer2A(TIME_1MS);  // initialize Timer2A which is used for software timer and decrease the sleepCt
+	tcbs[NUMTHREADS-1].next = 0;
+	FreePt = &tcbs[0];
+	RunPt = 0;
+	for(i = 0; i < NUMPRI; i++){
+		ReadyPt[i] = 0;
+	}
+	EdfNum = 0;
+	Preempting = 0;
+	Yielding = 0;
+	KilledPt = 0;
+	IdlePt = 0;
+	TimeoutPt = 0;
+	TickCount = 0;
+	NumPeriodic = NumPeriodicTimers = 0;
+	TickLoad = OS_AddPeriodicLoad("Tick", TIME_1MS, 2, TICKWCET);
+	InitTimer2A(TIME_1MS);  // initialize Timer2A which is used for software timer and the timeout queue
 	InitTimer3A();
   OS_ClearMsTime();
   
@@ -82,6 +187,8 @@ void OS_Init(void){int i;
   NVIC_ST_CURRENT_R = 0;      // any write to current clears it
 															// lowest PRI so only foreground interrupted
   NVIC_SYS_PRI3_R =(NVIC_SYS_PRI3_R&0x00FFFFFF)|0xE0000000; // priority 7
+	OS_AddThread(&IdleThread, 128, IDLEPRI);  // first tcb, so it is always available
+	IdlePt = ReadyPt[IDLEPRI];
 }
 
 void SetInitialStack(int i){
@@ -103,12 +210,17 @@ void SetInitialStack(int i){
   Stacks[i][STACKSIZE-16] = 0x04040404;  // R4
 }
 
+uint32_t static HighestReady(void);        // in Ready rings below
+tcbType static *NextReady(uint32_t p);
+
 ///******** OS_Launch ***************
 // start the scheduler, enable interrupts
 // Inputs: number of 20ns clock cycles for each time slice
 //         (maximum of 24 bits)
 // Outputs: none (does not return)
 void OS_Launch(unsigned long theTimeSlice){
+	RunPt = NextReady(HighestReady()); // highest priority thread goes first
+	SwitchTime = OS_Time();
 	NVIC_ST_RELOAD_R = theTimeSlice - 1; // reload value
   NVIC_ST_CTRL_R = 0x00000007; // enable, core clock and interrupt arm
   StartOS();                   // start on the first task
@@ -121,55 +233,635 @@ void OS_Launch(unsigned long theTimeSlice){
 // Same function as OS_Sleep(0)
 // input:  none
 // output: none
-void OS_Suspend(void) { 
+RAMFUNC void OS_Suspend(void) { 
+	Yielding = 1;           // give up the CPU even below the threshold
 	NVIC_ST_CURRENT_R  = 0; // reset counter
 	NVIC_INT_CTRL_R = 0x04000000;		// trigger SysTick
 }
 
+// Ready rings ------------------------------------------------------------------------------
+// One ring per priority, Scheduler runs the highest priority ring
+// that is not empty, round robin within the ring.  With OS_EDF,
+// deadline threads are kept in EdfHeap instead, and run before the
+// ring at OS_EDFPRI, earliest absolute deadline first.  Threads at
+// OS_SHAREPRI share the CPU in proportion to their tickets (stride
+// scheduling), the one with the lowest pass runs next, and its pass
+// grows by its stride for every us it runs.  Passes wrap in seconds,
+// so a thread that is not ready keeps only its distance from SharePass.
+// Called with interrupts disabled
+
+// 1 if deadline a is earlier than b, correct across the wrap
+#define EARLIER(a,b) ((int32_t)((a)-(b)) < 0)
+
+RAMFUNC void static HeapSet(uint32_t i, tcbType *thread){
+	EdfHeap[i] = thread;
+	thread->heapIndex = i;
+}
+
+// move entry i up while it is earlier than its parent
+RAMFUNC void static HeapUp(uint32_t i){
+	tcbType *thread = EdfHeap[i];
+	while ((i > 0) && EARLIER(thread->deadline, EdfHeap[(i-1)/2]->deadline)){
+		HeapSet(i, EdfHeap[(i-1)/2]);
+		i = (i-1)/2;
+	}
+	HeapSet(i, thread);
+}
+
+// move entry i down while a child is earlier
+RAMFUNC void static HeapDown(uint32_t i){
+	tcbType *thread = EdfHeap[i];
+	uint32_t child;
+	for (;;){
+		child = 2*i + 1;
+		if (child >= EdfNum){
+			break;
+		}
+		if ((child+1 < EdfNum) && EARLIER(EdfHeap[child+1]->deadline, EdfHeap[child]->deadline)){
+			child++;
+		}
+		if (!EARLIER(EdfHeap[child]->deadline, thread->deadline)){
+			break;
+		}
+		HeapSet(i, EdfHeap[child]);
+		i = child;
+	}
+	HeapSet(i, thread);
+}
+
+// highest priority with a ready thread, the idle thread is always ready
+RAMFUNC uint32_t static HighestReady(void){
+	uint32_t p = 0;
+	while ((ReadyPt[p] == 0) && ((p != OS_EDFPRI) || (EdfNum == 0))){
+		p++;
+	}
+	return p;
+}
+
+// the thread to run at priority p
+RAMFUNC tcbType static *NextReady(uint32_t p){
+	tcbType *pt, *bestPt;
+	if ((p == OS_EDFPRI) && EdfNum){
+		return EdfHeap[0];
+	}
+	bestPt = ReadyPt[p];
+	if (p == OS_SHAREPRI){      // lowest pass, the ring is short
+		for (pt = bestPt->next; pt != ReadyPt[p]; pt = pt->next){
+			if (EARLIER(pt->pass, bestPt->pass)){
+				bestPt = pt;
+			}
+		}
+	}
+	return bestPt;
+}
+
+// 1 if a ready thread may preempt the running one
+RAMFUNC int static Outranks(tcbType *thread, tcbType *runPt){
+	if (thread->priority < runPt->threshold){
+		return 1;
+	}
+	if (thread->edf && (thread->priority == runPt->priority) && (runPt->threshold == runPt->priority)){
+		return (runPt->edf == 0) || EARLIER(thread->deadline, runPt->deadline);
+	}
+	return 0;
+}
+
+// insert a thread at the end of the ring of its priority, so it runs
+// last in the round robin; if it outranks the preemption threshold of
+// the running thread, pend the switch now instead of waiting for the
+// time slice to end, from a thread the switch happens when interrupts
+// are enabled again, from an ISR SysTick tail-chains to it
+RAMFUNC void static LinkReady(tcbType *thread){
+	tcbType *headPt = ReadyPt[thread->priority];
+	thread->state = READY;
+	if (thread->tickets){       // back from blocked, sleeping or throttled
+		if ((int32_t)thread->pass < 0){
+			thread->pass = 0;       // no credit kept for time spent blocked
+		}
+		thread->pass += SharePass;
+	}
+	if (thread->edf){           // by deadline, not in a ring
+		EdfNum++;
+		HeapSet(EdfNum-1, thread);
+		HeapUp(EdfNum-1);
+	}
+	else if (headPt == 0){      // only ready thread at this priority
+		thread->next = thread;
+		thread->prev = thread;
+		ReadyPt[thread->priority] = thread;
+	}
+	else{                       // just before the next to run
+		thread->next = headPt;
+		thread->prev = headPt->prev;
+		headPt->prev->next = thread;
+		headPt->prev = thread;
+	}
+	if (RunPt && Outranks(thread, RunPt)){
+		Preempting = 1;
+		NVIC_ST_CURRENT_R = 0;    // full time slice for the woken thread
+		NVIC_INT_CTRL_R = 0x04000000; // trigger SysTick
+	}
+	else if (RunPt && (RunPt->state == READY) && (thread->priority < RunPt->priority)){
+		HeldOff++;                // runs when RunPt blocks or lowers its threshold
+	}
+}
+
+// remove a thread from its ring
+RAMFUNC void static UnlinkReady(tcbType *thread){
+	uint32_t i;
+	if (thread->tickets){       // SharePass may wrap before it is back
+		thread->pass -= SharePass;
+	}
+	if (thread->edf){
+		i = thread->heapIndex;
+		EdfNum--;
+		if (i != EdfNum){         // the last entry fills the hole
+			thread = EdfHeap[EdfNum];
+			HeapSet(i, thread);
+			HeapUp(i);
+			HeapDown(thread->heapIndex);
+		}
+		return;
+	}
+	if (thread->next == thread){
+		ReadyPt[thread->priority] = 0;
+		return;
+	}
+	thread->prev->next = thread->next;
+	thread->next->prev = thread->prev;
+	if (ReadyPt[thread->priority] == thread){
+		ReadyPt[thread->priority] = thread->next;
+	}
+}
+
+// Servers ------------------------------------------------------------------------------
+// A sporadic server lets aperiodic threads use at most Budget of the
+// CPU in any window of Period.  Time is charged to the server at each
+// switch.  A chunk of use starts when one of its threads is switched
+// in while the server is idle, and ends when that thread blocks, sleeps
+// or runs out of budget; what the chunk used comes back one Period
+// after it started.  So the server interferes with the threads below
+// its priority no more than a periodic thread of Budget every Period.
+// A thread that runs out of budget above its preemption threshold
+// finishes that section first; the overrun is charged all the same.
+// A reservation is a server whose whole budget comes back at the start
+// of every period instead, usually given to one thread with
+// OS_ServerAttach to keep a runaway thread to Budget every Period.
+
+ServerType *ServerList;        // every server
+
+// charge the running thread for the time since it was switched to
+RAMFUNC void static Charge(tcbType *thread){
+	unsigned long now = OS_Time();
+	unsigned long used = OS_TimeDifference(SwitchTime, now);
+	ServerType *serverPt = thread->server;
+	SwitchTime = now;
+	thread->cpu += used;
+	thread->pass += thread->stride*(used/80);
+	while (thread->cpu >= TIME_1MS){
+		thread->cpu -= TIME_1MS;
+		thread->cpuMs++;
+	}
+	if (serverPt){
+		serverPt->Remaining -= used;
+		serverPt->used += used;
+		serverPt->Used += used;
+		while (serverPt->Used >= TIME_1MS){
+			serverPt->Used -= TIME_1MS;
+			serverPt->UsedMs++;
+		}
+	}
+}
+
+// end the server's chunk of use, its time comes back a period after it started
+RAMFUNC void static ServerIdle(ServerType *serverPt){
+	uint32_t n = serverPt->numRepl;
+	if ((serverPt->active == 0) || serverPt->Reservation){
+		return;                    // a reservation's period runs on regardless
+	}
+	serverPt->active = 0;
+	if (serverPt->used == 0){
+		return;
+	}
+	if (n == OS_SERVERREPL){       // full, merge into the newest, which is later
+		n--;
+		serverPt->replAmount[n] += serverPt->used;
+	}
+	else{
+		serverPt->replAmount[n] = serverPt->used;
+		serverPt->numRepl = n+1;
+	}
+	serverPt->replTime[n] = serverPt->start + serverPt->Period;
+	serverPt->used = 0;
+}
+
+// a thread whose server ran out, to be continued by the replenishment
+RAMFUNC int static OutOfBudget(tcbType *thread){
+	return thread->server && (thread->server->Remaining <= 0) &&
+	       (thread->threshold == thread->priority);
+}
+
+RAMFUNC void static Throttle(tcbType *thread){
+	ServerType *serverPt = thread->server;
+	UnlinkReady(thread);
+	thread->state = THROTTLED;
+	thread->snext = serverPt->ThrottlePt;
+	serverPt->ThrottlePt = thread;
+	serverPt->Throttles++;
+	ServerIdle(serverPt);
+	if (serverPt->OnThrottle){
+		(*serverPt->OnThrottle)(thread->id);
+	}
+}
+
+// called every ms from Timer2A_Handler, with interrupts disabled
+// returns the budget, and stops a running thread that used its last
+RAMFUNC void static ServerTick(void){
+	ServerType *serverPt;
+	tcbType *thread;
+	uint32_t i;
+	for (serverPt = ServerList; serverPt; serverPt = serverPt->next){
+		if (serverPt->Reservation && ((int32_t)(TickCount - serverPt->start) >= (int32_t)serverPt->Period)){
+			serverPt->start += serverPt->Period;
+			if (serverPt->Remaining > 0){
+				serverPt->Remaining = 0;   // unused budget does not carry over
+			}
+			serverPt->Remaining += serverPt->Budget; // an overrun does
+		}
+		while (serverPt->numRepl && ((int32_t)(serverPt->replTime[0] - TickCount) <= 0)){
+			serverPt->Remaining += serverPt->replAmount[0];
+			if (serverPt->Remaining > (long)serverPt->Budget){
+				serverPt->Remaining = serverPt->Budget;
+			}
+			serverPt->numRepl--;
+			for (i = 0; i < serverPt->numRepl; i++){
+				serverPt->replTime[i] = serverPt->replTime[i+1];
+				serverPt->replAmount[i] = serverPt->replAmount[i+1];
+			}
+		}
+		while ((serverPt->Remaining > 0) && serverPt->ThrottlePt){
+			thread = serverPt->ThrottlePt;
+			serverPt->ThrottlePt = thread->snext;
+			LinkReady(thread);
+		}
+	}
+	if (RunPt && RunPt->server && (RunPt->threshold == RunPt->priority) &&
+	   ((long)OS_TimeDifference(SwitchTime, OS_Time()) >= RunPt->server->Remaining)){
+		NVIC_INT_CTRL_R = 0x04000000; // trigger SysTick, Scheduler throttles it
+	}
+}
+
+//******** OS_InitServer *************** 
+// initialize a sporadic server, its threads can run at most
+// budget ms in any period ms, then wait for their budget to return
+// Inputs: server, name for reports, budget and period in ms
+// Outputs: none
+void OS_InitServer(ServerType *serverPt, char *name, unsigned long budget, unsigned long period){
+	long status;
+	serverPt->name = name;
+	serverPt->Budget = budget*TIME_1MS;
+	serverPt->Period = period;
+	serverPt->Remaining = serverPt->Budget;
+	serverPt->active = 0;
+	serverPt->used = 0;
+	serverPt->numRepl = 0;
+	serverPt->ThrottlePt = 0;
+	serverPt->Throttles = 0;
+	serverPt->Used = serverPt->UsedMs = 0;
+	serverPt->Reservation = 0;
+	serverPt->OnThrottle = 0;
+	status = StartCritical();
+	serverPt->next = ServerList;
+	ServerList = serverPt;
+	EndCritical(status);
+}
+
+//******** OS_InitReservation *************** 
+// initialize a CPU reservation, its threads can run at most budget ms
+// in each period ms, then wait for the next period
+// Inputs: reservation, name for reports, budget and period in ms,
+//         function called with the thread id each time a thread is throttled,
+//         or 0; it runs in SysTick_Handler, so it must be short and not block
+// Outputs: none
+void OS_InitReservation(ServerType *serverPt, char *name, unsigned long budget,
+   unsigned long period, void(*onThrottle)(unsigned long id)){
+	long status;
+	OS_InitServer(serverPt, name, budget, period);
+	status = StartCritical();
+	serverPt->Reservation = 1;
+	serverPt->OnThrottle = onThrottle;
+	serverPt->active = 1;      // the first period starts now
+	serverPt->start = TickCount;
+	EndCritical(status);
+}
+
+//******** OS_ServerAttach *************** 
+// run a thread on a server's budget from now on
+// Inputs: thread id, as from OS_Id, server, or 0 to leave it
+// Outputs: 1 if successful, 0 if there is no such thread,
+//          or it is waiting for its budget
+int OS_ServerAttach(unsigned long id, ServerType *serverPt){
+	long status;
+	tcbType *thread;
+	if (id >= NUMTHREADS){
+		return 0;
+	}
+	thread = &tcbs[id];
+	status = StartCritical();
+	if ((thread->state == FREE) || (thread->state == THROTTLED)){
+		EndCritical(status);
+		return 0;
+	}
+	if (thread == RunPt){
+		Charge(RunPt);           // time so far is not the server's
+		if (RunPt->server){
+			ServerIdle(RunPt->server);
+		}
+	}
+	thread->server = serverPt;
+	if ((thread == RunPt) && serverPt && (serverPt->active == 0)){
+		serverPt->active = 1;
+		serverPt->start = TickCount;
+	}
+	EndCritical(status);
+	return 1;
+}
+
+//******** OS_ServerJoin *************** 
+// run the calling thread on a server's budget from now on
+// Inputs: server, or 0 to leave it
+// Outputs: none
+void OS_ServerJoin(ServerType *serverPt){
+	OS_ServerAttach(RunPt->id, serverPt);
+}
+
+//******** OS_ServerList *************** 
+// first server on the list, follow next for the others
+// Inputs: none
+// Outputs: pointer to the first server, null if none
+ServerType *OS_ServerList(void){
+	return ServerList;
+}
+
 //******** OS_AddThread *************** 
 // add a foregound thread to the scheduler
 // Inputs: pointer to a void/void foreground task
 //         number of bytes allocated for its stack
-//         priority, 0 is highest, 5 is the lowest
+//         priority, 0 is highest, 6 is the lowest, the highest
+//         ready thread runs, equal priorities share by time slice,
+//         at OS_SHAREPRI by OS_TICKETS tickets each
 // Outputs: 1 if successful, 0 if this thread can not be added
 // stack size must be divisable by 8 (aligned to double word boundary)
 static uint32_t ThreadNum = 0;
 int OS_AddThread(void(*task)(void), unsigned long stackSize, unsigned long priority) {
-	unsigned char i,j;	 
-	int32_t status,thread;
+	return OS_AddThreadArg((void(*)(void *))task, 0, stackSize, priority);
+}
+
+// deadline and period in ms, period 0 for a thread without deadlines
+// tickets for a thread at OS_SHAREPRI, 0 for OS_TICKETS
+int static AddThread(void(*task)(void *), void *arg, unsigned long stackSize, unsigned long priority,
+   unsigned long deadline, unsigned long period, unsigned long tickets) {
+	int32_t status,thread,i;
+	unsigned long start, time;
+	tcbType *newPt;
   status = StartCritical();
-  if (ThreadNum == NUMTHREADS){ // no available tcbs
+	start = OS_Time();
+  if (FreePt == 0){ // no available tcbs
 	  EndCritical(status);
 	  return 0;
   }
-  else{
-	  	if (ThreadNum == 0) {  // start add thread
-			tcbs[0].available = 0;
-			tcbs[0].next = &tcbs[0];  // first, create a single cycle
-			RunPt = &tcbs[0]; //start from tcbs[0]
-			thread = 0;
-		}
-		else{   // not the start
-			for (i=0;i<NUMTHREADS;i++) {
-				if (tcbs[i].available) break;   // find an available tcb for the new thread
+	newPt = FreePt;            // take the first available tcb
+	FreePt = newPt->next;
+	time = OS_TimeDifference(start, OS_Time());
+	EndCritical(status);
+	                           // nobody else can reach the tcb until LinkReady
+	newPt->numWaits = 0;
+	newPt->groupPt = 0;
+	if (IdlePt && (priority >= IDLEPRI)){
+		priority = IDLEPRI-1;    // the lowest is kept for the idle thread
+	}
+	newPt->edf = 0;
+	if (period && OS_EDF){
+		newPt->edf = 1;          // one level for all deadline threads
+		priority = OS_EDFPRI;
+	}
+	newPt->period = period;
+	newPt->relDeadline = deadline;
+	newPt->release = TickCount;
+	newPt->deadline = TickCount + deadline;
+	newPt->jobs = newPt->misses = 0;
+	newPt->tickets = newPt->stride = 0;
+	if (priority == OS_SHAREPRI){
+		if (tickets == 0){
+			tickets = OS_TICKETS;
+		}
+		newPt->tickets = tickets;
+		newPt->stride = OS_STRIDE1/tickets;
+		newPt->pass = 0;         // LinkReady starts it at SharePass
+	}
+	newPt->priority = priority;
+	newPt->threshold = priority;
+	newPt->switches = 0;
+	newPt->server = 0;
+	newPt->cpu = newPt->cpuMs = 0;
+	thread = newPt - tcbs;
+	newPt->id = thread;
+	for (i = 0; i < STACKSIZE-16; i++){
+		Stacks[thread][i] = STACKPAINT;
+	}
+	SetInitialStack(thread); 
+	Stacks[thread][STACKSIZE-2] = (int32_t)(task); // PC		
+	Stacks[thread][STACKSIZE-8] = (int32_t)(arg);  // R0
+
+	status = StartCritical();
+	start = OS_Time();
+	LinkReady(newPt);
+	ThreadNum++;
+	start = OS_TimeDifference(start, OS_Time());
+	if (start > time){
+		time = start;
+	}
+	if (time > MaxAddThreadCritical){
+		MaxAddThreadCritical = time;
+	}
+	EndCritical(status);
+	return 1; 
+}
+
+//******** OS_AddThreadArg *************** 
+// add a foregound thread that receives an argument, so one
+// function can be the body of many threads
+// Inputs: pointer to a void/void* foreground task
+//         argument passed to the task in R0
+//         number of bytes allocated for its stack
+//         priority, 0 is highest, 6 is the lowest, the highest
+//         ready thread runs, equal priorities share by time slice
+// Outputs: 1 if successful, 0 if this thread can not be added
+int OS_AddThreadArg(void(*task)(void *), void *arg, unsigned long stackSize, unsigned long priority) {
+	return AddThread(task, arg, stackSize, priority, 0, 0, 0);
+}
+
+//******** OS_AddDeadlineThread *************** 
+// add a periodic thread with a deadline in every period, it is released
+// now and then every period ms, and calls OS_WaitNextPeriod at the end of each job
+// with OS_EDF the ready deadline threads all run at priority OS_EDFPRI,
+// earliest absolute deadline first, ahead of other threads at that level;
+// without it they run at the given fixed priority
+// Inputs: pointer to a void/void foreground task
+//         number of bytes allocated for its stack
+//         deadline, ms after each release, at most the period
+//         period, ms
+//         priority, used only without OS_EDF
+// Outputs: 1 if successful, 0 if this thread can not be added
+int OS_AddDeadlineThread(void(*task)(void), unsigned long stackSize,
+   unsigned long deadline, unsigned long period, unsigned long priority){
+	if ((period == 0) || (deadline == 0) || (deadline > period)){
+		return 0;
+	}
+	return AddThread((void(*)(void *))task, 0, stackSize, priority, deadline, period, 0);
+}
+
+//******** OS_AddShareThread *************** 
+// add a best-effort thread at priority OS_SHAREPRI, below the real-time
+// priorities, the ready threads there get CPU time in proportion to
+// their tickets instead of equal time slices
+// Inputs: pointer to a void/void foreground task
+//         number of bytes allocated for its stack
+//         tickets, 1 to OS_MAXTICKETS
+// Outputs: 1 if successful, 0 if this thread can not be added
+int OS_AddShareThread(void(*task)(void), unsigned long stackSize, unsigned long tickets){
+	if ((tickets == 0) || (tickets > OS_MAXTICKETS)){
+		return 0;
+	}
+	return AddThread((void(*)(void *))task, 0, stackSize, OS_SHAREPRI, 0, 0, tickets);
+}
+
+//******** OS_SetTickets *************** 
+// change the tickets of a thread at OS_SHAREPRI, while it runs
+// its new share starts with its next time slice
+// Inputs: thread id, as from OS_Id, tickets 1 to OS_MAXTICKETS
+// Outputs: 1 if successful, 0 if it is not a share thread
+int OS_SetTickets(unsigned long id, unsigned long tickets){
+	long status;
+	if ((id >= NUMTHREADS) || (tickets == 0) || (tickets > OS_MAXTICKETS)){
+		return 0;
+	}
+	status = StartCritical();
+	if ((tcbs[id].state == FREE) || (tcbs[id].tickets == 0)){
+		EndCritical(status);
+		return 0;
+	}
+	tcbs[id].tickets = tickets;
+	tcbs[id].stride = OS_STRIDE1/tickets;
+	EndCritical(status);
+	return 1;
+}
+
+//******** OS_SetThreshold *************** 
+// set the preemption threshold of the running thread, while it runs
+// only threads with a priority above the threshold can preempt it,
+// so threads between the two wait until it blocks, sleeps or yields
+// Inputs: threshold, 0 to the thread's priority, OS_NOTHRESHOLD turns it off
+// Outputs: none
+void OS_SetThreshold(unsigned long threshold){
+	long status;
+	uint32_t p;
+	status = StartCritical();
+	if (threshold > RunPt->priority){
+		threshold = RunPt->priority;
+	}
+	RunPt->threshold = threshold;
+	p = HighestReady();
+	if ((p < threshold) ||       // lowered below a thread held off
+	   ((threshold == RunPt->priority) && (NextReady(p) != RunPt) && Outranks(NextReady(p), RunPt))){
+		Preempting = 1;
+		NVIC_INT_CTRL_R = 0x04000000; // trigger SysTick
+	}
+	else if (RunPt->server && (threshold == RunPt->priority) &&
+	   ((long)OS_TimeDifference(SwitchTime, OS_Time()) >= RunPt->server->Remaining)){
+		NVIC_INT_CTRL_R = 0x04000000; // budget ran out inside the section
+	}
+	EndCritical(status);
+}
+
+//******** OS_ThreadStats *************** 
+// Inputs: tcb number, 0 to the number of tcbs - 1
+//         where to copy the statistics
+// Outputs: 1 if the tcb holds a thread, 0 if it is free,
+//          -1 if there is no such tcb
+int OS_ThreadStats(unsigned long id, ThreadStatsType *stats){
+	int32_t *pt;
+	if (id >= NUMTHREADS){
+		return -1;
+	}
+	stats->id = id;
+	stats->priority = tcbs[id].priority;
+	stats->threshold = tcbs[id].threshold;
+	stats->state = tcbs[id].state;
+	stats->Switches = tcbs[id].switches;
+	stats->CPU = tcbs[id].cpuMs;
+	stats->Jobs = tcbs[id].jobs;
+	stats->Misses = tcbs[id].misses;
+	stats->Tickets = tcbs[id].tickets;
+	pt = &Stacks[id][0];
+	while ((pt < &Stacks[id][STACKSIZE]) && (*pt == STACKPAINT)){
+		pt++;                    // words never written
+	}
+	stats->StackUsed = &Stacks[id][STACKSIZE] - pt;
+	return tcbs[id].state != FREE;
+}
+
+//******** OS_StackNeeded *************** 
+// total stack the current threads have used, in words
+// Inputs: 0 for one stack per thread, as allocated now
+//         1 for the worst case if threads that can not preempt
+//         one another shared a stack, the deepest chain of
+//         preemptions allowed by the priorities and thresholds
+// Outputs: words, ISR frames not included
+// one caller at a time, it keeps its work area in a static
+unsigned long OS_StackNeeded(int shared){
+	static unsigned long depth[NUMTHREADS]; // deepest chain starting at this thread, too big for a thread stack
+	ThreadStatsType stats;
+	unsigned long i, j, p, deepest, edfUsed, total = 0;
+	for (i = 0; i < NUMTHREADS; i++){
+		depth[i] = 0;
+		if ((shared == 0) && (OS_ThreadStats(i, &stats) == 1)){
+			total += stats.StackUsed;
+		}
+	}
+	if (shared == 0){
+		return total;
+	}
+	edfUsed = 0;                   // deadline threads at one level preempt one another by deadline
+	for (i = 0; i < NUMTHREADS; i++){
+		if ((OS_ThreadStats(i, &stats) == 1) && tcbs[i].edf){
+			edfUsed += stats.StackUsed;
+		}
+	}
+	for (p = 0; p < NUMPRI; p++){  // j preempts i only if j is higher, so go top down
+		for (i = 0; i < NUMTHREADS; i++){
+			if ((OS_ThreadStats(i, &stats) != 1) || (stats.priority != p)){
+				continue;
+			}
+			deepest = 0;
+			for (j = 0; j < NUMTHREADS; j++){
+				if ((tcbs[j].state != FREE) && (tcbs[j].priority < stats.threshold)
+				   && (depth[j] > deepest)){
+					deepest = depth[j];
+				}
 			}
-			thread = i;
-			tcbs[i].available = 0; // make this tcb no longer available
-			for (j = (thread + NUMTHREADS - 1)%NUMTHREADS; j != thread; j = (j + NUMTHREADS - 1)%NUMTHREADS){
-				if (tcbs[j].available == 0) break; // find a previous tcb which has been used
+			if (tcbs[i].edf && (stats.threshold == p)){
+				depth[i] = edfUsed + deepest;  // all of them may be stacked
+			}
+			else{
+				depth[i] = stats.StackUsed + deepest;
+			}
+			if (depth[i] > total){
+				total = depth[i];
 			}
-			// add this tcb into the link list cycle
-			tcbs[thread].next = tcbs[j].next;  
-			tcbs[j].next = &tcbs[thread];
 		}
-		tcbs[thread].id = thread;
-	
-		SetInitialStack(thread); 
-		Stacks[thread][STACKSIZE-2] = (int32_t)(task); // PC		
-		ThreadNum++;
-		EndCritical(status);
-		return 1; 
-	}            
+	}
+	return total;
 }
 	 
 //******** OS_Id *************** 
@@ -180,20 +872,144 @@ unsigned long OS_Id(void) {
 	return RunPt->id;
 }
 	 
-// ******** OS_Wait ************
-// decrement semaphore 
-// input:  pointer to a counting semaphore
-// output: none
-void OS_Wait(Sema4Type *semaPt){
-	// Your code here.
+// Timeout queue ------------------------------------------------------------------------------
+// One queue, sorted by wakeTime, holds sleeping threads and threads in a
+// timed wait, so each tick only looks at the head.
+// Called with interrupts disabled
+
+void static TimeoutInsert(tcbType *thread, unsigned long ticks){
+	tcbType *prevPt, *nextPt;
+	thread->wakeTime = TickCount + ticks;
+	prevPt = 0;
+	nextPt = TimeoutPt;
+	while (nextPt && ((int32_t)(nextPt->wakeTime - thread->wakeTime) <= 0)){
+		prevPt = nextPt;         // equal times stay in FIFO order
+		nextPt = nextPt->tnext;
+	}
+	thread->timed = 1;
+	thread->tnext = nextPt;
+	thread->tprev = prevPt;
+	if (nextPt){
+		nextPt->tprev = thread;
+	}
+	if (prevPt){
+		prevPt->tnext = thread;
+	}
+	else{
+		TimeoutPt = thread;
+	}
 }
 
-// ******** OS_Signal ************
-// increment semaphore 
-// input:  pointer to a counting semaphore
-// output: none
-void OS_Signal(Sema4Type *semaPt){
-	// Your code here.
+RAMFUNC void static TimeoutRemove(tcbType *thread){
+	thread->timed = 0;
+	if (thread->tnext){
+		thread->tnext->tprev = thread->tprev;
+	}
+	if (thread->tprev){
+		thread->tprev->tnext = thread->tnext;
+	}
+	else{
+		TimeoutPt = thread->tnext;
+	}
+}
+
+// Semaphores ------------------------------------------------------------------------------
+// Value counts the free units and never goes negative. Waiting threads
+// are kept in a circular FIFO, BlockPt is the oldest. A signal with
+// waiters present hands its unit directly to the oldest one.
+// The uncontended paths run without masking interrupts: OS_TryDecrement,
+// OS_TryIncrement and OS_TrySet in osasm.s update Value with LDREX/STREX.
+// Exception entry clears the exclusive monitor, so a fast path that was
+// interrupted by a kernel update retries. The kernel paths below run with
+// interrupts disabled, so they see a consistent Value and BlockPt.
+
+// remove a waiter from its semaphore's list, called with interrupts disabled
+RAMFUNC void static WaitRemove(waitType *waitPt){
+	Sema4Type *semaPt = waitPt->semaPt;
+	if (waitPt->next == waitPt){
+		semaPt->BlockPt = 0;     // it was the only waiter
+	}
+	else{
+		waitPt->prev->next = waitPt->next;
+		waitPt->next->prev = waitPt->prev;
+		if (semaPt->BlockPt == waitPt){
+			semaPt->BlockPt = waitPt->next;
+		}
+	}
+}
+
+// take a thread off every semaphore it is waiting on, called with interrupts disabled
+RAMFUNC void static WaitRemoveAll(tcbType *thread){
+	uint32_t i;
+	for (i = 0; i < thread->numWaits; i++){
+		WaitRemove(&thread->waits[i]);
+	}
+	thread->numWaits = 0;
+}
+
+// add a waiter at the end of its semaphore's list, called with interrupts disabled
+void static WaitAppend(waitType *waitPt){
+	Sema4Type *semaPt = waitPt->semaPt;
+	if (semaPt->BlockPt == 0){
+		waitPt->next = waitPt;
+		waitPt->prev = waitPt;
+		semaPt->BlockPt = waitPt;
+	}
+	else{                    // append, BlockPt->prev is the newest
+		waitPt->next = semaPt->BlockPt;
+		waitPt->prev = semaPt->BlockPt->prev;
+		waitPt->prev->next = waitPt;
+		semaPt->BlockPt->prev = waitPt;
+	}
+}
+
+// block the running thread on one or more semaphores, called with interrupts disabled
+// waits[i].semaPt must be set by the caller
+// returns with interrupts disabled, after the thread runs again
+// Inputs: wait entries, number of entries, timeout in ms or OS_FOREVER
+// Outputs: 1 + index of the semaphore that was signaled, 0 if timed out
+int static Block(waitType *waits, uint32_t num, unsigned long timeout){
+	tcbType *thisPt = RunPt;
+	uint32_t i;
+	for (i = 0; i < num; i++){
+		waits[i].thread = thisPt;
+		WaitAppend(&waits[i]);
+	}
+	thisPt->waits = waits;
+	thisPt->numWaits = num;
+	UnlinkReady(thisPt);
+	thisPt->state = BLOCKED;
+	if (timeout != OS_FOREVER){
+		TimeoutInsert(thisPt, timeout);
+	}
+	OS_Suspend();
+	OS_EnableInterrupts();     // switch happens here
+	OS_DisableInterrupts();
+	return thisPt->waitStatus;
+}
+
+// block the running thread on a single semaphore, see Block
+int static BlockOne(Sema4Type *semaPt, unsigned long timeout){
+	RunPt->wait.semaPt = semaPt;
+	return Block(&RunPt->wait, 1, timeout);
+}
+
+void static CoHandOver(waitType *waitPt);    // in Coroutines below
+
+// wake the oldest waiter with a successful status, called with interrupts disabled
+RAMFUNC void static WakeOne(Sema4Type *semaPt){
+	waitType *waitPt = semaPt->BlockPt;
+	tcbType *thread = waitPt->thread;
+	if (thread == 0){          // a coroutine in OS_CO_WAIT
+		CoHandOver(waitPt);
+		return;
+	}
+	thread->waitStatus = (waitPt - thread->waits) + 1;
+	WaitRemoveAll(thread);
+	if (thread->timed){
+		TimeoutRemove(thread);
+	}
+	LinkReady(thread);
 }
 
 // ******** OS_InitSemaphore ************
@@ -201,21 +1017,273 @@ void OS_Signal(Sema4Type *semaPt){
 // input:  pointer to a semaphore
 // output: none
 void OS_InitSemaphore(Sema4Type *semaPt, long value){
-	// Your code here.
+	semaPt->Value = value;
+	semaPt->BlockPt = 0;
+}
+
+// ******** OS_Wait ************
+// decrement semaphore, block while it is zero
+// input:  pointer to a counting semaphore
+// output: none
+RAMFUNC void OS_Wait(Sema4Type *semaPt){
+	OS_WaitTimeout(semaPt, OS_FOREVER);
+}
+
+// ******** OS_WaitTimeout ************
+// decrement semaphore, block at most timeout ms while it is zero
+// input:  pointer to a counting semaphore
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: 1 if decremented, 0 if timed out
+int OS_WaitTimeout(Sema4Type *semaPt, unsigned long timeout){
+	int result = 1;
+	if (OS_TryDecrement(semaPt)){
+		return 1;                // free, no kernel entry
+	}
+	OS_DisableInterrupts();
+	if (semaPt->Value > 0){
+		semaPt->Value = semaPt->Value - 1;
+	}
+	else if (timeout == 0){
+		result = 0;
+	}
+	else{
+		result = BlockOne(semaPt, timeout);  // OS_Signal hands the unit over
+	}
+	OS_EnableInterrupts();
+	return result;
+}
+
+// ******** OS_Signal ************
+// increment semaphore, or wake the oldest waiting thread
+// input:  pointer to a counting semaphore
+// output: none
+RAMFUNC void OS_Signal(Sema4Type *semaPt){
+	long status;
+	if (OS_TryIncrement(semaPt)){
+		return;                  // nobody waiting, no kernel entry
+	}
+	status = StartCritical();
+	if (semaPt->BlockPt){
+		WakeOne(semaPt);
+	}
+	else{
+		semaPt->Value = semaPt->Value + 1;
+	}
+	EndCritical(status);
 }
 
 // ******** OS_bWait ************
 // input:  pointer to a binary semaphore
 // output: none
-void OS_bWait(Sema4Type *semaPt){
-	// Your code here.
+RAMFUNC void OS_bWait(Sema4Type *semaPt){
+	OS_bWaitTimeout(semaPt, OS_FOREVER);
 }	
 
+// ******** OS_bWaitTimeout ************
+// input:  pointer to a binary semaphore
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: 1 if acquired, 0 if timed out
+int OS_bWaitTimeout(Sema4Type *semaPt, unsigned long timeout){
+	int result = 1;
+	if (OS_TryDecrement(semaPt)){
+		return 1;                // free, no kernel entry
+	}
+	OS_DisableInterrupts();
+	if (semaPt->Value){
+		semaPt->Value = 0;
+	}
+	else if (timeout == 0){
+		result = 0;
+	}
+	else{
+		result = BlockOne(semaPt, timeout);  // OS_bSignal hands the flag over
+	}
+	OS_EnableInterrupts();
+	return result;
+}
+
 // ******** OS_bSignal ************ 
 // input:  pointer to a binary semaphore
 // output: none
-void OS_bSignal(Sema4Type *semaPt){
-	// Your code here.
+RAMFUNC void OS_bSignal(Sema4Type *semaPt){
+	long status;
+	if (OS_TrySet(semaPt)){
+		return;                  // nobody waiting, no kernel entry
+	}
+	status = StartCritical();
+	if (semaPt->BlockPt){
+		WakeOne(semaPt);
+	}
+	else{
+		semaPt->Value = 1;
+	}
+	EndCritical(status);
+}
+
+// ******** OS_WaitAny ************
+// wait until any one of several semaphores can be taken
+// takes a unit from the first available one, in list order
+// works with counting and binary semaphores, and queues guarded by one
+// input:  array of pointers to semaphores
+//         number of semaphores, 1 to MAXWAITANY
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: index in list of the semaphore taken, -1 if timed out
+int OS_WaitAny(Sema4Type *list[], unsigned long num, unsigned long timeout){
+	waitType waits[MAXWAITANY];   // live on this stack while blocked
+	unsigned long i;
+	int result = -1;
+	if (num > MAXWAITANY){
+		num = MAXWAITANY;
+	}
+	OS_DisableInterrupts();
+	for (i = 0; i < num; i++){
+		if (list[i]->Value > 0){
+			list[i]->Value = list[i]->Value - 1;
+			result = i;
+			break;
+		}
+	}
+	if (result < 0 && timeout != 0 && num != 0){
+		for (i = 0; i < num; i++){
+			waits[i].semaPt = list[i];
+		}
+		result = Block(waits, num, timeout) - 1;  // a signal hands its unit over
+	}
+	OS_EnableInterrupts();
+	return result;
+}
+
+// Event Groups ------------------------------------------------------------------------------
+// 32 flags per group. A flag is set or cleared with one store to its
+// bit-band alias, so OS_FlagSet and OS_FlagClear never mask interrupts
+// to update Flags; only waking waiting threads needs a critical section.
+
+// alias word of one bit of an SRAM variable, 0x20000000-0x200FFFFF
+#define BITBAND_SRAM(addr, bit) (*((volatile uint32_t *)(0x22000000 + \
+  ((((uint32_t)(addr)) - 0x20000000) << 5) + ((bit) << 2))))
+
+// flags of the group that satisfy a waiter, 0 if not satisfied yet
+uint32_t static FlagMatch(EventGroupType *groupPt, uint32_t mask, uint32_t options){
+	uint32_t match = groupPt->Flags & mask;
+	if ((options & OS_FLAG_ALL) && (match != mask)){
+		return 0;
+	}
+	return match;
+}
+
+// take a thread off its group's list of waiters, called with interrupts disabled
+RAMFUNC void static FlagWaitRemove(tcbType *thread){
+	tcbType **pt = &thread->groupPt->BlockPt;
+	while (*pt != thread){
+		pt = &(*pt)->fnext;
+	}
+	*pt = thread->fnext;
+	thread->groupPt = 0;
+}
+
+// wake every waiter whose condition now holds, called with interrupts disabled
+void static FlagWake(EventGroupType *groupPt){
+	tcbType *thread, *nextPt;
+	uint32_t match;
+	for (thread = groupPt->BlockPt; thread; thread = nextPt){
+		nextPt = thread->fnext;
+		match = FlagMatch(groupPt, thread->flagMask, thread->flagOptions);
+		if (match){
+			if (thread->flagOptions & OS_FLAG_CLEAR){
+				groupPt->Flags &= ~match;
+			}
+			FlagWaitRemove(thread);
+			if (thread->timed){
+				TimeoutRemove(thread);
+			}
+			thread->waitStatus = match;
+			LinkReady(thread);
+		}
+	}
+}
+
+// ******** OS_InitEventGroup ************
+// initialize event group, all flags clear
+// input:  pointer to an event group
+// output: none
+void OS_InitEventGroup(EventGroupType *groupPt){
+	groupPt->Flags = 0;
+	groupPt->BlockPt = 0;
+}
+
+// ******** OS_FlagSet ************
+// set flags and wake the threads waiting for them
+// can be called from foreground threads and from ISRs
+// input:  pointer to an event group (in SRAM)
+//         flags to set
+// output: none
+void OS_FlagSet(EventGroupType *groupPt, uint32_t mask){
+	uint32_t bit;
+	long status;
+	for (bit = 0; mask; bit++, mask >>= 1){
+		if (mask & 1){
+			BITBAND_SRAM(&groupPt->Flags, bit) = 1;  // atomic single store
+		}
+	}
+	if (groupPt->BlockPt){
+		status = StartCritical();
+		FlagWake(groupPt);
+		EndCritical(status);
+	}
+}
+
+// ******** OS_FlagClear ************
+// clear flags, can be called from foreground threads and from ISRs
+// input:  pointer to an event group (in SRAM)
+//         flags to clear
+// output: none
+void OS_FlagClear(EventGroupType *groupPt, uint32_t mask){
+	uint32_t bit;
+	for (bit = 0; mask; bit++, mask >>= 1){
+		if (mask & 1){
+			BITBAND_SRAM(&groupPt->Flags, bit) = 0;  // atomic single store
+		}
+	}
+}
+
+// ******** OS_FlagWait ************
+// wait until any or all of the flags in mask are set
+// input:  pointer to an event group
+//         flags to wait for
+//         OS_FLAG_ANY or OS_FLAG_ALL, plus OS_FLAG_CLEAR to consume
+//         the matching flags
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: flags that satisfied the wait, 0 if timed out
+uint32_t OS_FlagWait(EventGroupType *groupPt, uint32_t mask,
+   uint32_t options, unsigned long timeout){
+	tcbType *thisPt;
+	uint32_t match;
+	OS_DisableInterrupts();
+	match = FlagMatch(groupPt, mask, options);
+	if (match){
+		if (options & OS_FLAG_CLEAR){
+			groupPt->Flags &= ~match;
+		}
+	}
+	else if (timeout != 0){
+		thisPt = RunPt;
+		thisPt->flagMask = mask;
+		thisPt->flagOptions = options;
+		thisPt->groupPt = groupPt;
+		thisPt->fnext = groupPt->BlockPt;
+		groupPt->BlockPt = thisPt;
+		UnlinkReady(thisPt);
+		thisPt->state = BLOCKED;
+		if (timeout != OS_FOREVER){
+			TimeoutInsert(thisPt, timeout);
+		}
+		OS_Suspend();
+		OS_EnableInterrupts();   // switch happens here
+		OS_DisableInterrupts();
+		match = thisPt->waitStatus;
+	}
+	OS_EnableInterrupts();
+	return match;
 }
 
 // ******** OS_Sleep ************
@@ -224,7 +1292,43 @@ void OS_bSignal(Sema4Type *semaPt){
 // output: none
 // OS_Sleep(0) implements cooperative multitasking
 void OS_Sleep(unsigned long sleepTime){
-	// Your code here.
+	if (sleepTime == 0){
+		OS_Suspend();
+		return;
+	}
+	OS_DisableInterrupts();
+	UnlinkReady(RunPt);
+	RunPt->state = SLEEPING;
+	TimeoutInsert(RunPt, sleepTime);
+	OS_Suspend();
+	OS_EnableInterrupts();     // switch happens here
+}
+
+//******** OS_WaitNextPeriod *************** 
+// end the current job of a deadline thread, counts a miss if it ended
+// after its deadline, and sleeps until the next release
+// a job that ended after the next release starts the next one at once
+// Inputs: none
+// Outputs: none
+void OS_WaitNextPeriod(void){
+	long status;
+	status = StartCritical();
+	RunPt->jobs++;
+	if (EARLIER(RunPt->deadline, TickCount)){
+		RunPt->misses++;
+	}
+	UnlinkReady(RunPt);          // out of deadline order before the deadline moves
+	RunPt->release += RunPt->period;
+	RunPt->deadline = RunPt->release + RunPt->relDeadline;
+	if (EARLIER(TickCount, RunPt->release)){
+		RunPt->state = SLEEPING;
+		TimeoutInsert(RunPt, RunPt->release - TickCount);
+	}
+	else{
+		LinkReady(RunPt);          // late, next job is already released
+	}
+	OS_Suspend();
+	EndCritical(status);         // switch happens here
 }
 
 // ******** OS_Kill ************
@@ -232,21 +1336,153 @@ void OS_Sleep(unsigned long sleepTime){
 // input:  none
 // output: none
 void OS_Kill(void){
-	unsigned char i;
-	int32_t thread;
-	RunPt->available = 1;
-	thread = OS_Id();
-	for (i = (thread + NUMTHREADS - 1) % NUMTHREADS; i != thread; i = (i + NUMTHREADS - 1) % NUMTHREADS){
-		if (tcbs[i].available == 0) 
-			break;   // find the previous used tcb
-	}
+	int32_t status;
+	unsigned long start;
+	status = StartCritical();
+	start = OS_Time();
+	UnlinkReady(RunPt);
+	RunPt->state = FREE;
+	KilledPt = RunPt;           // Scheduler puts it on the free list after the switch
 	ThreadNum--;
-  tcbs[i].next = tcbs[thread].next;	
+	start = OS_TimeDifference(start, OS_Time());
+	if (start > MaxKillCritical){
+		MaxKillCritical = start;
+	}
 	OS_Suspend(); // switch the thread
+	EndCritical(status);
+	for(;;){}     // never returns
 }	
 
-void Scheduler(void){
-	RunPt = RunPt->next;
+// pick the next thread, called from SysTick_Handler with interrupts disabled
+// a thread whose time slice ended or that called OS_Suspend goes to
+// the end of its ring, one that was preempted stays at the front
+// a thread running above its threshold keeps the CPU when its time
+// slice ends, unless a thread above the threshold is ready
+RAMFUNC void Scheduler(void){
+	uint32_t p;
+	tcbType *oldPt = RunPt;
+	Charge(RunPt);
+	if ((RunPt->state == READY) && OutOfBudget(RunPt)){
+		Throttle(RunPt);
+	}
+	else if (RunPt->server && (RunPt->state != READY)){
+		ServerIdle(RunPt->server);  // blocked, slept or killed
+	}
+	p = HighestReady();         // idle thread is always ready at IDLEPRI
+	if ((RunPt->state == READY) && (Preempting == 0)){
+		if ((Yielding == 0) && (p >= RunPt->threshold) && (RunPt->threshold < RunPt->priority)){
+			return;                 // time slice ended, nothing may preempt it
+		}
+		if (RunPt->edf == 0){       // deadline threads stay in deadline order
+			ReadyPt[RunPt->priority] = RunPt->next;
+		}
+	}
+	if (Preempting){
+		Preemptions++;
+	}
+	Preempting = 0;
+	Yielding = 0;
+	RunPt = NextReady(p);
+	while (OutOfBudget(RunPt)){  // woke up on a spent server
+		Throttle(RunPt);
+		RunPt = NextReady(HighestReady());
+	}
+	if (RunPt->tickets){
+		SharePass = RunPt->pass;
+	}
+	if (RunPt->server && (RunPt->server->active == 0)){
+		RunPt->server->active = 1;  // a new chunk of use starts
+		RunPt->server->start = TickCount;
+	}
+	if (RunPt != oldPt){
+		ContextSwitches++;
+		RunPt->switches++;
+	}
+	if (KilledPt){              // old stack is no longer in use
+		KilledPt->next = FreePt;
+		FreePt = KilledPt;
+		KilledPt = 0;
+	}
+}
+
+// Periodic tasks ------------------------------------------------------------------------------
+// Every periodic load on the CPU, with its period, NVIC priority and
+// worst case execution time (WCET), so a new one is only accepted if
+// every deadline (the end of its period) is still met.  Tasks started
+// by OS_AddPeriodicThread run on Timer1A and Timer4A and are timed on
+// every run; other periodic ISRs, like the kernel tick, are declared
+// with OS_AddPeriodicLoad and report their own run times.
+
+// run one periodic task and time it
+RAMFUNC void static RunPeriodic(periodicType *pt){
+	unsigned long time = OS_Time();
+	(*pt->task)();
+	OS_PeriodicTime(pt - Periodic, OS_TimeDifference(time, OS_Time()));
+}
+
+// WCET used by the analysis, the larger of the estimate and the longest run
+unsigned long static Wcet(periodicType *pt){
+	return (pt->MaxTime > pt->wcet) ? pt->MaxTime : pt->wcet;
+}
+
+// worst case response time of entry i, 12.5ns units
+// R = C(i) + sum over j at the same or higher priority of ceil(R/T(j))*C(j),
+// iterated from R = C(i) until it stops growing or passes the period
+// equal priorities are counted as interference, they can be pending first
+unsigned long static ResponseTime(unsigned long i){
+	unsigned long j, r, next = Wcet(&Periodic[i]);
+	do{
+		r = next;
+		next = Wcet(&Periodic[i]);
+		for(j = 0; j < NumPeriodic; j++){
+			if((j != i) && (Periodic[j].priority <= Periodic[i].priority)){
+				next += ((r + Periodic[j].period - 1)/Periodic[j].period)*Wcet(&Periodic[j]);
+			}
+		}
+	}while((next != r) && (next <= Periodic[i].period));
+	return next;
+}
+
+// response time analysis of every entry, 1 if every one meets its period
+int static Feasible(void){
+	unsigned long i;
+	int ok = 1;
+	for(i = 0; i < NumPeriodic; i++){
+		Periodic[i].Response = ResponseTime(i);
+		if(Periodic[i].Response > Periodic[i].period){
+			ok = 0;
+		}
+	}
+	return ok;
+}
+
+// add an entry if the set stays feasible, returns its index or -1
+int static AdmitPeriodic(void(*task)(void), char *name, unsigned long period,
+   unsigned long priority, unsigned long wcet){
+	periodicType *pt;
+	long status;
+	status = StartCritical();
+	if((NumPeriodic == MAXPERIODIC) || (period == 0)){
+		EndCritical(status);
+		return -1;
+	}
+	pt = &Periodic[NumPeriodic];
+	pt->task = task;
+	pt->name = name;
+	pt->period = period;
+	pt->priority = priority;
+	pt->wcet = wcet;
+	pt->MaxTime = 0;
+	pt->Runs = 0;
+	NumPeriodic++;
+	if(Feasible() == 0){
+		NumPeriodic--;           // refused, the others keep their old results
+		Feasible();
+		EndCritical(status);
+		return -1;
+	}
+	EndCritical(status);
+	return pt - Periodic;
 }
 
 //******** OS_AddPeriodicThread *************** 
@@ -263,17 +1499,655 @@ void Scheduler(void){
 // This task does not have a Thread ID
 int OS_AddPeriodicThread(void(*task)(void), 
    unsigned long period, unsigned long priority) { 
-	static uint16_t PeriodTaskCt;
-	if (PeriodTaskCt == 0){
-		PeriodicTask1 = task;
+	return OS_AddPeriodicThreadWCET(task, "Periodic", period, priority, 0);
+}
+
+//******** OS_AddPeriodicThreadWCET *************** 
+// add a background periodic task after a response time analysis
+// of every periodic load, with its deadline at the end of its period
+// Inputs: pointer to a void/void background function, name for reports
+//         period given in system time units (12.5ns)
+//         priority 0 is the highest, 5 is the lowest
+//         worst case execution time in 12.5ns units, or 0 to rely on
+//         the longest run measured, which OS_PeriodicCheck uses later
+// Outputs: 1 if added, 0 if a deadline could be missed or no timer is free
+int OS_AddPeriodicThreadWCET(void(*task)(void), char *name,
+   unsigned long period, unsigned long priority, unsigned long wcet){
+	int id;
+	if (NumPeriodicTimers == NUMPERIODICTIMERS){
+		return 0;
+	}
+	id = AdmitPeriodic(task, name, period, priority, wcet);
+	if (id < 0){
+		return 0;
+	}
+	PeriodicTimer[NumPeriodicTimers] = &Periodic[id];
+	if (NumPeriodicTimers == 0){
 		InitTimer1A(period,priority);
 	}
 	else {
-		PeriodicTask2 = task;
 		InitTimer4A(period,priority);
 	}
-	PeriodTaskCt++;
-  return 1;
+	NumPeriodicTimers++;
+	return 1;
+}
+
+//******** OS_AddPeriodicLoad *************** 
+// declare a periodic ISR started elsewhere, so the analysis counts it
+// Inputs: name, period in 12.5ns units, NVIC priority 0 to 7,
+//         worst case execution time in 12.5ns units, or 0 if measured
+// Outputs: id for OS_PeriodicTime, -1 if a deadline could be missed
+int OS_AddPeriodicLoad(char *name, unsigned long period,
+   unsigned long priority, unsigned long wcet){
+	return AdmitPeriodic(0, name, period, priority, wcet);
+}
+
+//******** OS_PeriodicTime *************** 
+// record how long one run of a periodic load took
+// Inputs: id from OS_AddPeriodicLoad, run time in 12.5ns units
+// Outputs: none
+RAMFUNC void OS_PeriodicTime(int id, unsigned long time){
+	if (id < 0){
+		return;
+	}
+	Periodic[id].Runs++;
+	if (time > Periodic[id].MaxTime){
+		Periodic[id].MaxTime = time;
+	}
+}
+
+//******** OS_PeriodicCheck *************** 
+// repeat the response time analysis with the run times measured so far
+// Inputs: none
+// Outputs: 1 if every periodic load meets its deadline, 0 if not
+int OS_PeriodicCheck(void){
+	long status;
+	int ok;
+	status = StartCritical();
+	ok = Feasible();
+	EndCritical(status);
+	return ok;
+}
+
+//******** OS_PeriodicStats *************** 
+// Inputs: entry, 0 to the number of periodic loads - 1
+//         where to copy it, Response as of the last analysis
+// Outputs: 1 if copied, 0 if there is no such entry
+// the fields in 12.5ns units can be reported in us by dividing by 80
+int OS_PeriodicStats(unsigned long i, periodicType *stats){
+	if (i >= NumPeriodic){
+		return 0;
+	}
+	*stats = Periodic[i];
+	return 1;
+}
+
+//******** OS_PeriodicUtilization *************** 
+// Inputs: none
+// Outputs: CPU use of every periodic load in 0.1%, by the WCETs used
+//          in the analysis; rate monotonic priorities are guaranteed
+//          below n(2^(1/n)-1) for n loads, 1000, 828, 779, 756, 743,
+//          734, 728, 724, but response times are exact at any use
+unsigned long OS_PeriodicUtilization(void){
+	unsigned long i, use = 0;
+	for(i = 0; i < NumPeriodic; i++){
+		use += (Wcet(&Periodic[i])*1000 + Periodic[i].period/2)/Periodic[i].period;
+	}
+	return use;
+}
+
+// Cyclic executive ------------------------------------------------------------------------------
+// A const table of (offset, task) entries is run again every major
+// frame from Timer5A.  The timer reloads in hardware with the gap to
+// the next entry, written one entry ahead (TAILD), so dispatch does not
+// drift with ISR latency.  Tasks run to completion in the ISR, like
+// periodic tasks, and threads run in the time between them.  A task
+// still running when the next entry is due is an overrun, and that
+// entry runs late, right after it.
+
+const CyclicEntryType *CyclicTable;
+uint32_t CyclicNum;            // entries in CyclicTable
+uint32_t CyclicFrame;          // ms per major frame
+uint32_t CyclicIndex;          // entry the next timeout runs
+cyclicStatsType CyclicStats[OS_MAXCYCLIC];
+
+// ms from entry i to the one after it, across the end of the frame
+RAMFUNC uint32_t static CyclicGap(uint32_t i){
+	if (i+1 < CyclicNum){
+		return CyclicTable[i+1].offset - CyclicTable[i].offset;
+	}
+	return CyclicFrame - CyclicTable[i].offset + CyclicTable[0].offset;
+}
+
+void InitTimer5A(uint32_t first, uint32_t next, uint32_t priority);
+
+//******** OS_CyclicStart *************** 
+// run a schedule table from Timer5A, the first frame starts 1 ms from now
+// call once, the table must stay in place, it is not copied
+// Inputs: table of entries, offsets in ms from the start of the frame,
+//         increasing, all below the frame length
+//         number of entries, 1 to OS_MAXCYCLIC
+//         frame, ms per major frame
+//         priority of Timer5A, 0 to 5, the tasks run at this NVIC priority
+// Outputs: 1 if started, 0 if the table is not valid
+int OS_CyclicStart(const CyclicEntryType *table, unsigned long num,
+   unsigned long frame, unsigned long priority){
+	unsigned long i;
+	if ((num == 0) || (num > OS_MAXCYCLIC) || (table[num-1].offset >= frame)){
+		return 0;
+	}
+	for (i = 1; i < num; i++){
+		if (table[i].offset <= table[i-1].offset){
+			return 0;
+		}
+	}
+	for (i = 0; i < num; i++){
+		CyclicStats[i].Runs = CyclicStats[i].MaxTime = CyclicStats[i].Overruns = 0;
+	}
+	CyclicTable = table;
+	CyclicNum = num;
+	CyclicFrame = frame;
+	CyclicIndex = 0;
+	InitTimer5A((table[0].offset+1)*TIME_1MS, CyclicGap(0)*TIME_1MS, priority);
+	return 1;
+}
+
+//******** OS_CyclicStats *************** 
+// Inputs: entry, 0 to the number of entries - 1, where to copy its statistics
+// Outputs: 1 if copied, 0 if there is no such entry
+int OS_CyclicStats(unsigned long i, cyclicStatsType *stats){
+	if (i >= CyclicNum){
+		return 0;
+	}
+	*stats = CyclicStats[i];
+	return 1;
+}
+
+
+// Thread Pool ------------------------------------------------------------------------------
+
+#define POOLSIZE		8						// Maximum number of workers
+#define JOBFIFOSIZE	16					// Maximum number of queued jobs, must be a power of 2
+
+struct job {
+	void (*task)(void *);  // job body, runs to completion on a worker thread
+	void *arg;             // argument passed to the job
+};
+typedef struct job jobType;
+
+jobType static JobFifo[JOBFIFOSIZE];
+unsigned long volatile JobPutI;   // put next
+unsigned long volatile JobGetI;   // get next
+Sema4Type JobsAvailable;          // number of jobs in JobFifo
+ChannelType JobChannel;           // policy and statistics of JobFifo
+
+void static PoolWorker(void *arg){
+	jobType job;
+	long status;
+	for(;;){
+		OS_Wait(&JobsAvailable);
+		status = StartCritical();
+		job = JobFifo[JobGetI&(JOBFIFOSIZE-1)];
+		JobGetI++;
+		EndCritical(status);
+		OS_ChannelGet(&JobChannel);
+		(*job.task)(job.arg);
+	}
+}
+
+// remove the oldest job without running it, for OS_CHANNEL_DROPOLD
+// takes a JobsAvailable unit like a worker, so a worker that
+// already took its unit still finds a job
+// returns 0 if every queued job is already claimed by a worker
+int static JobDiscard(void){
+	long status;
+	if(OS_WaitTimeout(&JobsAvailable, 0) == 0){
+		return 0;
+	}
+	status = StartCritical();
+	JobGetI++;
+	EndCritical(status);
+	OS_Signal(&JobChannel.Room);
+	return 1;
+}
+
+//******** OS_ThreadPool_Init *************** 
+// create the worker threads that run jobs given to OS_ThreadPool_Submit
+// call once, before OS_Launch
+// Inputs: number of worker threads, 1 to POOLSIZE
+//         number of bytes allocated for each worker's stack
+//         priority of the workers, 0 is highest, 5 is the lowest
+// Outputs: number of workers created
+int OS_ThreadPool_Init(unsigned long numWorkers, unsigned long stackSize, unsigned long priority){
+	unsigned long i;
+	int created = 0;
+	JobPutI = JobGetI = 0;
+	OS_ChannelInit(&JobChannel, "Jobs", JOBFIFOSIZE, OS_CHANNEL_REJECT, 0);
+	OS_InitSemaphore(&JobsAvailable, 0);
+	if(numWorkers > POOLSIZE){
+		numWorkers = POOLSIZE;
+	}
+	for(i = 0; i < numWorkers; i++){
+		created += OS_AddThreadArg(&PoolWorker, (void *)i, stackSize, priority);
+	}
+	return created;
+}
+
+//******** OS_ThreadPool_Submit *************** 
+// queue a job for the next idle worker thread
+// can be called from foreground threads and from ISRs
+// a full queue is handled by the policy of JobChannel, only
+// foreground threads block and the default is to refuse the job
+// the job runs to completion and returns; it may block or sleep,
+// but must not call OS_Kill
+// Inputs: pointer to a void/void* job
+//         argument passed to the job
+// Outputs: 1 if successful, 0 if the job queue is full
+int OS_ThreadPool_Submit(void(*task)(void *), void *arg){
+	long status;
+	int room;
+	while((room = OS_ChannelReserve(&JobChannel)) == OS_CHANNEL_REPLACE){
+		if(JobDiscard() == 0){
+			room = OS_CHANNEL_FULL;  // drop the new job instead
+			break;
+		}
+	}
+	if(room == OS_CHANNEL_FULL){
+		return 0;                // Failed, job queue full
+	}
+	status = StartCritical();
+	JobFifo[JobPutI&(JOBFIFOSIZE-1)].task = task;
+	JobFifo[JobPutI&(JOBFIFOSIZE-1)].arg = arg;
+	JobPutI++;
+	OS_ChannelPut(&JobChannel, JobPutI-JobGetI);
+	EndCritical(status);
+	OS_Signal(&JobsAvailable);
+	return 1;
+}
+
+
+
+// Channels ------------------------------------------------------------------------------
+
+ChannelType *ChannelList;         // every initialized channel
+
+//******** OS_ChannelInit *************** 
+// clear the statistics and put the channel on the list
+// call from the FIFO's own initialization
+// Inputs: channel, name for the report, capacity in elements,
+//         policy (OS_CHANNEL_REJECT ...), timeout in ms for OS_CHANNEL_BLOCK
+// Outputs: none
+void OS_ChannelInit(ChannelType *chPt, char *name, unsigned long capacity,
+   unsigned long policy, unsigned long timeout){
+	ChannelType *pt;
+	long status;
+	status = StartCritical();
+	chPt->name = name;
+	chPt->Policy = policy;
+	chPt->Timeout = timeout;
+	chPt->Capacity = capacity;
+	OS_InitSemaphore(&chPt->Room, capacity);
+	chPt->Puts = chPt->Gets = chPt->Drops = chPt->HighWater = 0;
+	for(pt = ChannelList; pt; pt = pt->next){
+		if(pt == chPt){
+			break;                 // initialized again, already listed
+		}
+	}
+	if(pt == 0){
+		chPt->next = ChannelList;
+		ChannelList = chPt;
+	}
+	EndCritical(status);
+}
+
+//******** OS_ChannelPolicy *************** 
+// change what happens when the channel is full
+// Inputs: channel, policy, timeout in ms for OS_CHANNEL_BLOCK
+// Outputs: none
+void OS_ChannelPolicy(ChannelType *chPt, unsigned long policy, unsigned long timeout){
+	chPt->Timeout = timeout;
+	chPt->Policy = policy;
+}
+
+//******** OS_ChannelReserve *************** 
+// producer side, called before putting one element
+// applies the policy when the channel is full, counts drops
+// Inputs: channel
+// Outputs: OS_CHANNEL_ROOM, OS_CHANNEL_FULL or OS_CHANNEL_REPLACE
+int OS_ChannelReserve(ChannelType *chPt){
+	unsigned long timeout = 0;
+	if((chPt->Policy == OS_CHANNEL_BLOCK) &&
+	   ((NVIC_INT_CTRL_R&NVIC_INT_CTRL_VEC_ACT_M) == 0)){
+		timeout = chPt->Timeout;     // only threads may wait
+	}
+	if(OS_WaitTimeout(&chPt->Room, timeout)){
+		return OS_CHANNEL_ROOM;
+	}
+	chPt->Drops++;
+	if(chPt->Policy == OS_CHANNEL_DROPOLD){
+		return OS_CHANNEL_REPLACE;   // the oldest element's room is reused
+	}
+	return OS_CHANNEL_FULL;
+}
+
+//******** OS_ChannelPut *************** 
+// producer side, called after an element was put
+// Inputs: channel, elements now in the channel
+// Outputs: none
+void OS_ChannelPut(ChannelType *chPt, unsigned long size){
+	chPt->Puts++;
+	if(size > chPt->HighWater){
+		chPt->HighWater = size;
+	}
+}
+
+//******** OS_ChannelGet *************** 
+// consumer side, called after an element was removed, frees its room
+// Inputs: channel
+// Outputs: none
+void OS_ChannelGet(ChannelType *chPt){
+	chPt->Gets++;
+	OS_Signal(&chPt->Room);
+}
+
+//******** OS_ChannelList *************** 
+// first channel on the list, follow next for the others
+// Inputs: none
+// Outputs: pointer to the first channel, null if none
+ChannelType *OS_ChannelList(void){
+	return ChannelList;
+}
+
+
+// Run-to-completion Tasks ------------------------------------------------------------------------------
+// Short event handlers that never block share one stack instead of
+// each getting a thread.  Each of the RTCLEVELS priorities has its
+// own software-triggered interrupt (UART4-7 vectors, unused on this
+// board) at NVIC priority RTCBASEPRI+level, below the device ISRs and
+// above SysTick.  The NVIC then gives stack resource policy behavior:
+// a task starts only if it outranks the running task and the ceiling
+// in BASEPRI, tasks of one level never preempt each other, and a task
+// that has started always finishes before anything below it resumes.
+// RTC_Entry in osasm.s moves SP to RTCStack on the outermost entry.
+
+#define RTCLEVELS    4          // priorities 0 (highest) to 3
+#define RTCTASKS     16         // most tasks
+#define RTCSTACKSIZE 128        // words, shared by all tasks and ISRs that nest in them
+#define RTCBASEPRI   3          // NVIC priority of level 0
+#define RTCIRQ       60         // interrupt number of level 0, UART4
+
+struct rtc {
+	void (*task)(void);
+	unsigned long level;          // 0 to RTCLEVELS-1
+	unsigned long volatile pending; // activations not run yet
+	unsigned long volatile delay;   // ms until OS_RTC_ActivateIn fires, 0 if none
+	unsigned long Runs;           // completed activations
+};
+typedef struct rtc rtcType;
+
+rtcType RTCTasks[RTCTASKS];
+unsigned long NumRTCTasks;
+unsigned long volatile RTCDelays;  // tasks with a delay running
+__align(8) int32_t RTCStack[RTCSTACKSIZE];
+int32_t * const RTCStackTop = &RTCStack[RTCSTACKSIZE];
+unsigned long RTCNest;             // nesting of RTC_Entry, used in osasm.s
+unsigned long OS_RaiseBasePri(unsigned long basepri);
+void OS_SetBasePri(unsigned long basepri);
+
+//******** OS_AddRTCTask *************** 
+// add a run-to-completion task, it runs on the shared stack
+// each time OS_RTC_Activate is called
+// Inputs: pointer to a void/void task
+//         priority 0 is the highest, 3 is the lowest, all above threads
+// Outputs: task id 0 to 15, or -1 if no room
+// The task can call OS_Signal, OS_bSignal, OS_RTC_Activate and
+// any put that does not block; it can not spin, wait, sleep, or kill
+int OS_AddRTCTask(void(*task)(void), unsigned long priority){
+	long status;
+	int id;
+	uint32_t irq, shift;
+	if(priority >= RTCLEVELS){
+		priority = RTCLEVELS-1;
+	}
+	status = StartCritical();
+	if(NumRTCTasks == RTCTASKS){
+		EndCritical(status);
+		return -1;
+	}
+	id = NumRTCTasks;
+	RTCTasks[id].task = task;
+	RTCTasks[id].level = priority;
+	RTCTasks[id].pending = 0;
+	RTCTasks[id].delay = 0;
+	RTCTasks[id].Runs = 0;
+	NumRTCTasks++;
+	irq = RTCIRQ + priority;           // 60-63 are all in NVIC_PRI15_R
+	shift = 8*(irq&3) + 5;
+	NVIC_PRI15_R = (NVIC_PRI15_R&~(7 << shift))|((RTCBASEPRI+priority) << shift);
+	NVIC_EN1_R = 1 << (irq-32);
+	EndCritical(status);
+	return id;
+}
+
+//******** OS_RTC_Activate *************** 
+// request one run of a task, from a thread, ISR or another task
+// it runs as soon as it is the highest priority work above the ceiling
+// Inputs: task id from OS_AddRTCTask
+// Outputs: none
+void OS_RTC_Activate(int id){
+	long status;
+	status = StartCritical();
+	RTCTasks[id].pending++;
+	EndCritical(status);
+	NVIC_SW_TRIG_R = RTCIRQ + RTCTasks[id].level;
+}
+
+//******** OS_RTC_ActivateIn *************** 
+// request one run of a task after a delay, replaces a delay already running
+// Inputs: task id from OS_AddRTCTask, delay in ms (1 or more)
+// Outputs: none
+void OS_RTC_ActivateIn(int id, unsigned long ms){
+	long status;
+	status = StartCritical();
+	if(RTCTasks[id].delay == 0){
+		RTCDelays++;
+	}
+	RTCTasks[id].delay = ms;
+	EndCritical(status);
+}
+
+// called every ms from Timer2A_Handler, with interrupts disabled
+RAMFUNC void static RTCTick(void){
+	unsigned long i;
+	if(RTCDelays == 0){
+		return;
+	}
+	for(i = 0; i < NumRTCTasks; i++){
+		if(RTCTasks[i].delay){
+			RTCTasks[i].delay--;
+			if(RTCTasks[i].delay == 0){
+				RTCDelays--;
+				OS_RTC_Activate(i);
+			}
+		}
+	}
+}
+
+// called from RTC_Entry on the shared stack
+// runs every pending task of one level, in the order they were added
+void OS_RTC_Run(unsigned long level){
+	unsigned long i;
+	long status;
+	int again = 1;
+	while(again){
+		again = 0;
+		for(i = 0; i < NumRTCTasks; i++){
+			if((RTCTasks[i].level == level) && RTCTasks[i].pending){
+				status = StartCritical();
+				RTCTasks[i].pending--;
+				EndCritical(status);
+				(*RTCTasks[i].task)();
+				RTCTasks[i].Runs++;
+				again = 1;
+			}
+		}
+	}
+}
+
+//******** OS_RTC_Lock *************** 
+// stack resource policy lock of a resource shared by RTC tasks
+// raises the system ceiling to the priority of the highest
+// task that uses the resource, so none of them can start
+// Inputs: ceiling, the highest priority (0 to 3) of the resource's users
+// Outputs: previous ceiling, to give to OS_RTC_Unlock
+// Locks nest, and can also be taken by threads
+unsigned long OS_RTC_Lock(unsigned long ceiling){
+	return OS_RaiseBasePri((RTCBASEPRI+ceiling) << 5);
+}
+
+//******** OS_RTC_Unlock *************** 
+// Inputs: value returned by the matching OS_RTC_Lock
+// Outputs: none
+void OS_RTC_Unlock(unsigned long previous){
+	OS_SetBasePri(previous);
+}
+
+
+// Coroutines ------------------------------------------------------------------------------
+// Stackless tasks, see OS_CO_BEGIN in os.h.  One thread runs all of
+// them: a coroutine returns to CoScheduler each time it yields, sleeps
+// or finds its semaphore busy, so a switch is one return and one call,
+// and a coroutine costs its CoType instead of a TCB and a stack.
+// A coroutine that finds its semaphore busy waits in the semaphore's
+// FIFO with thread 0; WakeOne hands it the unit through CoHandOver,
+// which signals CoReady, so nothing is polled.
+
+CoType *CoList;                // every coroutine, in the order added
+CoType *CoLast;
+unsigned long CoSwitches;      // calls of coroutines
+Sema4Type CoReady;             // a coroutine can go on, CoScheduler waits on it
+
+// give a waiting coroutine the unit of a signal and wake the coroutine
+// thread, called from WakeOne with interrupts disabled
+void static CoHandOver(waitType *waitPt){
+	CoType *co = (CoType *)waitPt;  // wait is the first member
+	WaitRemove(waitPt);
+	co->state = OS_CO_READY;
+	if (CoReady.BlockPt){
+		WakeOne(&CoReady);
+	}
+	else{
+		CoReady.Value = 1;
+	}
+}
+
+// the coroutine thread, run every coroutine that can go on
+// when none can, wait on CoReady until a signal hands a waiting
+// coroutine its unit or one is added, or until the next wake time,
+// with no coroutine asleep the wait never times out
+void static CoScheduler(void){
+	CoType *co;
+	unsigned long wait;
+	int ready,state;
+	for(;;){
+		ready = 0;
+		wait = OS_FOREVER;
+		for(co = CoList; co; co = co->next){
+			if(co->state == OS_CO_SLEEPING){
+				if((int32_t)(co->wake - TickCount) > 0){
+					if(co->wake - TickCount < wait){
+						wait = co->wake - TickCount;
+					}
+					continue;
+				}
+			}
+			else if((co->state == OS_CO_WAITING) || (co->state == OS_CO_DONE)){
+				continue;              // CoHandOver makes a waiter ready
+			}
+			state = (*co->task)(co);
+			CoSwitches++;
+			if(state != OS_CO_WAITING){
+				co->state = state;     // OS_Co_Wait set WAITING before a signal could clear it
+			}
+			if(state == OS_CO_READY){
+				ready = 1;
+			}
+		}
+		if(ready){
+			OS_Suspend();          // let threads of the same priority in
+		}
+		else{
+			OS_bWaitTimeout(&CoReady, wait);
+		}
+	}
+}
+
+//******** OS_Co_Init *************** 
+// create the thread that runs every coroutine
+// Inputs: stack size in words, for the deepest call made by any coroutine
+//         priority of the thread, 0 is the highest
+// Outputs: 1 if successful, 0 if the thread can not be added
+int OS_Co_Init(unsigned long stackSize, unsigned long priority){
+	OS_InitSemaphore(&CoReady, 0);
+	return OS_AddThread(&CoScheduler, stackSize, priority);
+}
+
+//******** OS_AddCoTask *************** 
+// add a coroutine, it starts at OS_CO_BEGIN the next time round
+// Inputs: coroutine, its function, argument it finds in co->arg
+// Outputs: none
+void OS_AddCoTask(CoType *co, int(*task)(CoType *co), void *arg){
+	long status;
+	co->lc = 0;
+	co->state = OS_CO_READY;
+	co->wait.thread = 0;
+	co->wait.semaPt = 0;
+	co->task = task;
+	co->arg = arg;
+	co->next = 0;
+	status = StartCritical();
+	if(CoLast){
+		CoLast->next = co;
+	}
+	else{
+		CoList = co;
+	}
+	CoLast = co;
+	EndCritical(status);
+	OS_bSignal(&CoReady);      // start it if CoScheduler is waiting
+}
+
+//******** OS_Co_Now *************** 
+// kernel time for OS_CO_SLEEP, unlike OS_MsTime it is never cleared
+// Inputs: none
+// Outputs: time in ms
+unsigned long OS_Co_Now(void){
+	return TickCount;
+}
+
+//******** OS_Co_Wait *************** 
+// take one unit of a semaphore for OS_CO_WAIT, or queue the
+// coroutine on it until a signal hands one over
+// Inputs: coroutine, pointer to a counting or binary semaphore
+// Outputs: 1 if taken, 0 if the coroutine waits
+int OS_Co_Wait(CoType *co, Sema4Type *semaPt){
+	int result = 1;
+	if (OS_TryDecrement(semaPt)){
+		return 1;                // free, no kernel entry
+	}
+	OS_DisableInterrupts();
+	if (semaPt->Value > 0){
+		semaPt->Value = semaPt->Value - 1;
+	}
+	else{
+		co->wait.thread = 0;
+		co->wait.semaPt = semaPt;
+		co->state = OS_CO_WAITING; // before a signal can hand the unit over
+		WaitAppend(&co->wait);
+		result = 0;
+	}
+	OS_EnableInterrupts();
+	return result;
 }
 
 
@@ -286,7 +2160,7 @@ int OS_AddPeriodicThread(void(*task)(void),
 // The time resolution should be less than or equal to 1us, and the precision 32 bits
 // It is ok to change the resolution and precision of this function as long as 
 //   this function and OS_TimeDifference have the same resolution and precision 
-unsigned long OS_Time(void) { 
+RAMFUNC unsigned long OS_Time(void) { 
 	return TIMER3_TAILR_R - TIMER3_TAV_R;
 }
 
@@ -297,7 +2171,7 @@ unsigned long OS_Time(void) {
 // The time resolution should be less than or equal to 1us, and the precision at least 12 bits
 // It is ok to change the resolution and precision of this function as long as 
 //   this function and OS_Time have the same resolution and precision 
-unsigned long OS_TimeDifference(unsigned long start, unsigned long stop) {
+RAMFUNC unsigned long OS_TimeDifference(unsigned long start, unsigned long stop) {
 	return stop-start;
 }
 
@@ -351,9 +2225,9 @@ void InitTimer1A(unsigned long period, uint32_t priority) {
   EndCritical(sr);
 }
 
-void Timer1A_Handler(void){ 
+RAMFUNC void Timer1A_Handler(void){ 
   TIMER1_ICR_R = TIMER_ICR_TATOCINT;// acknowledge timer1A timeout
-	(*PeriodicTask1)();
+	RunPeriodic(PeriodicTimer[0]);
 }
 
 void InitTimer2A(unsigned long period) {
@@ -382,9 +2256,31 @@ void InitTimer2A(unsigned long period) {
   EndCritical(sr);
 }
 
-void Timer2A_Handler(void){ 
+RAMFUNC void Timer2A_Handler(void){ 
+	tcbType *thread;
+	long status;
+	unsigned long start = OS_Time();
 	TIMER2_ICR_R = TIMER_ICR_TATOCINT;// acknowledge timer2A timeout
 	MSTime++;
+	status = StartCritical();         // semaphores are signaled from higher priority ISRs too
+	TickCount++;
+	while (TimeoutPt && ((int32_t)(TimeoutPt->wakeTime - TickCount) <= 0)){
+		thread = TimeoutPt;             // sleep finished or wait timed out
+		TimeoutRemove(thread);
+		if (thread->numWaits){
+			WaitRemoveAll(thread);
+			thread->waitStatus = 0;
+		}
+		if (thread->groupPt){
+			FlagWaitRemove(thread);
+			thread->waitStatus = 0;
+		}
+		LinkReady(thread);
+	}
+	ServerTick();
+	RTCTick();                      // OS_RTC_ActivateIn may run in a higher ISR
+	EndCritical(status);
+	OS_PeriodicTime(TickLoad, OS_TimeDifference(start, OS_Time()));
 }
 
 void InitTimer3A(void) {
@@ -442,9 +2338,55 @@ void InitTimer4A(uint32_t period, uint32_t priority) {
   EndCritical(sr);
 }
 
-void Timer4A_Handler(void){ 
+RAMFUNC void Timer4A_Handler(void){ 
   TIMER4_ICR_R = TIMER_ICR_TATOCINT;// acknowledge timer4A timeout
-	(*PeriodicTask2)();
+	RunPeriodic(PeriodicTimer[1]);
+}
+
+// first timeout after first, then after next, later gaps come from Timer5A_Handler
+void InitTimer5A(uint32_t first, uint32_t next, uint32_t priority) {
+	long sr;
+	
+	sr = StartCritical();
+  SYSCTL_RCGCTIMER_R |= 0x20;
+	
+  while((SYSCTL_RCGCTIMER_R & 0x20) == 0){} // allow time for clock to stabilize
+	
+  TIMER5_CTL_R &= ~TIMER_CTL_TAEN; // 1) disable timer5A during setup
+                                   // 2) configure for 32-bit timer mode
+  TIMER5_CFG_R = TIMER_CFG_32_BIT_TIMER;
+                                   // 3) configure for periodic mode, reload written at the next timeout
+  TIMER5_TAMR_R = TIMER_TAMR_TAMR_PERIOD|TIMER_TAMR_TAILD;
+  TIMER5_TAILR_R = first - 1;      // 4) reload value
+                                   // 5) clear timer5A timeout flag
+  TIMER5_ICR_R = TIMER_ICR_TATOCINT;
+  TIMER5_IMR_R |= TIMER_IMR_TATOIM;// 6) arm timeout interrupt
+								   // 7) priority shifted to bits 7-5 for timer5A
+  NVIC_PRI23_R = (NVIC_PRI23_R&0xFFFFFF00)|(priority << 5);
+  NVIC_EN2_R = NVIC_EN2_INT92;     // 8) enable interrupt 92 in NVIC
+  TIMER5_TAPR_R = 0;
+  TIMER5_CTL_R |= TIMER_CTL_TAEN;  // 9) enable timer5A
+  TIMER5_TAILR_R = next - 1;       // counted after the first timeout
+	
+  EndCritical(sr);
+}
+
+// run one entry of the schedule table and time it
+RAMFUNC void Timer5A_Handler(void){ 
+	uint32_t i = CyclicIndex;
+	unsigned long start = OS_Time();
+  TIMER5_ICR_R = TIMER_ICR_TATOCINT;// acknowledge timer5A timeout
+	CyclicIndex = (i+1 == CyclicNum) ? 0 : i+1;
+	TIMER5_TAILR_R = CyclicGap(CyclicIndex)*TIME_1MS - 1; // the gap after the next entry
+	(*CyclicTable[i].task)();
+	start = OS_TimeDifference(start, OS_Time());
+	CyclicStats[i].Runs++;
+	if (start > CyclicStats[i].MaxTime){
+		CyclicStats[i].MaxTime = start;
+	}
+	if (TIMER5_RIS_R & TIMER_RIS_TATORIS){
+		CyclicStats[i].Overruns++;     // the next entry is already due
+	}
 }
 
 // Button Tasks ------------------------------------------------------------------------
@@ -496,20 +2438,19 @@ void ButtonTwoInit(uint8_t priority){
 	Last2 = BUTTON2;
 }
 
+int Debounce1, Debounce2;  // run-to-completion task ids
+
+// run-to-completion tasks, 10ms after the touch
 void static DebouncePD6(void) {
-  OS_Sleep(10);      //foreground sleep, must run within 5ms
   Last1 = BUTTON1;
   GPIO_PORTD_ICR_R = 0x40;
   GPIO_PORTD_IM_R |= 0x40;
-  OS_Kill(); 
 }
 
 void static DebouncePD7(void) {
-  OS_Sleep(10);      //foreground sleep, must run within 5ms
   Last2 = BUTTON2;
   GPIO_PORTD_ICR_R = 0x80;
   GPIO_PORTD_IM_R |= 0x80;
-  OS_Kill(); 
 }
 
 void GPIOPortD_Handler(void) {  // called on touch of either SW1 or SW2
@@ -519,14 +2460,14 @@ void GPIOPortD_Handler(void) {  // called on touch of either SW1 or SW2
 		if (Last1){
 			(*ButtonOneTask)();
 		}
-		OS_AddThread(DebouncePD6,128,2);
+		OS_RTC_ActivateIn(Debounce1, 10);
 	}
 	else if(GPIO_PORTD_RIS_R & 0x80){  // BUTTON2 touched
 		GPIO_PORTD_IM_R &= ~0x80;  //disarm interrupt on PD7
 		if (Last2){
 			(*ButtonTwoTask)();
 		}
-		OS_AddThread(DebouncePD7,128,2);
+		OS_RTC_ActivateIn(Debounce2, 10);
 	}
 }
 
@@ -540,7 +2481,12 @@ void GPIOPortD_Handler(void) {  // called on touch of either SW1 or SW2
 // This task can call OS_Signal  OS_bSignal	 OS_AddThread
 // This task does not have a Thread ID
 int OS_AddSW1Task(void(*task)(void), unsigned long priority) { 
-	// Your code here.
+	ButtonOneTask = task;
+	Debounce1 = OS_AddRTCTask(&DebouncePD6, RTCLEVELS-1);
+	if(Debounce1 < 0){
+		return 0;
+	}
+	ButtonOneInit(priority);
 	return 1;
 }
 
@@ -554,6 +2500,11 @@ int OS_AddSW1Task(void(*task)(void), unsigned long priority) {
 // This task can call issue OS_Signal, it can call OS_AddThread
 // This task does not have a Thread ID
 int OS_AddSW2Task(void(*task)(void), unsigned long priority) { 
-	// Your code here.
+	ButtonTwoTask = task;
+	Debounce2 = OS_AddRTCTask(&DebouncePD7, RTCLEVELS-1);
+	if(Debounce2 < 0){
+		return 0;
+	}
+	ButtonTwoInit(priority);
 	return 1;
 }
@@ -25,6 +25,7 @@
 #define NVIC_EN0_INT21          0x00200000  // Interrupt 21 enable
 #define NVIC_EN1_INT35					0x00000008
 #define NVIC_EN2_INT70          0x00000040
+#define NVIC_EN2_INT92          0x10000000
 
 #define TIMER_CFG_32_BIT_TIMER  0x00000000  // 32-bit timer configuration
 #define TIMER_TAMR_TACDIR       0x00000010  // GPTM Timer A Count Direction
@@ -45,13 +46,52 @@
 #define TIME_500US  (TIME_1MS/2)  
 #define TIME_250US  (TIME_1MS/5)  
 
+#define OS_FOREVER  0xFFFFFFFF     // timeout that never expires
+#define OS_NOTHRESHOLD 0xFFFFFFFF  // preemption threshold at the thread's own priority
+
+// 1 schedules deadline threads earliest deadline first (EDF) at one level,
+// 0 runs them at their own fixed priority, to compare the two
+#ifndef OS_EDF
+#define OS_EDF 1
+#endif
+#define OS_EDFPRI 1                // priority of the deadline threads with OS_EDF
+
+// 1 puts the context switch, the scheduler, the semaphore paths and the
+// kernel timer ISRs in section .ramfunc, so they run from SRAM without
+// flash wait states; link with ramfunc.sct, __main copies the section at
+// boot, and assemble osasm.s with --pd "OS_RAMFUNC SETL {TRUE}";
+// without it osasm.s stays in flash, and os.c and osasm.s do not link
+// unless both settings agree
+#ifndef OS_RAMFUNC
+#define OS_RAMFUNC 0
+#endif
+#if OS_RAMFUNC
+#define RAMFUNC __attribute__((section(".ramfunc")))
+#else
+#define RAMFUNC
+#endif
+#define OS_SHAREPRI 6              // lowest thread priority, shared by tickets
+#define OS_TICKETS 100             // tickets of a thread added at OS_SHAREPRI by OS_AddThread
+#define OS_MAXTICKETS 1000
+#define OS_STRIDE1 0x10000         // stride of a thread with one ticket
+
 // feel free to change the type of semaphore, there are lots of good solutions
+// Value and BlockPt offsets are used by the fast paths in osasm.s
 struct  Sema4{
   long Value;   // >0 means free, otherwise means busy        
-// add other components here, if necessary to implement blocking
+  struct wait *BlockPt;   // oldest blocked thread, 0 if none
 };
 typedef struct Sema4 Sema4Type;
 
+// Entry in the list of threads blocked on a semaphore
+// a coroutine in OS_CO_WAIT has one too, with thread 0
+struct wait {
+  struct tcb *thread;    // Waiting thread, 0 for a coroutine
+  struct wait *next;     // Linked list pointer, next waiter in FIFO order
+  struct wait *prev;     // Linked list pointer, previous waiter
+  Sema4Type *semaPt;     // Semaphore waited on
+};
+
 // ******** OS_Init ************
 // initialize operating system, disable interrupts until OS_Launch
 // initialize OS controlled I/O: serial, ADC, systick, LaunchPad I/O and timers 
@@ -71,6 +111,23 @@ void OS_InitSemaphore(Sema4Type *semaPt, long value);
 // output: none
 void OS_Wait(Sema4Type *semaPt); 
 
+// ******** OS_WaitTimeout ************
+// decrement semaphore, give up after timeout ms
+// input:  pointer to a counting semaphore
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: 1 if successful, 0 if timed out
+int OS_WaitTimeout(Sema4Type *semaPt, unsigned long timeout); 
+
+// ******** OS_WaitAny ************
+// wait until any one of several semaphores can be taken
+// takes a unit from the first available one, in list order
+// works with counting and binary semaphores, and queues guarded by one
+// input:  array of pointers to semaphores
+//         number of semaphores, 1 to 4
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: index in list of the semaphore taken, -1 if timed out
+int OS_WaitAny(Sema4Type *list[], unsigned long num, unsigned long timeout);
+
 // ******** OS_Signal ************
 // increment semaphore  
 // input:  pointer to a counting semaphore
@@ -82,21 +139,310 @@ void OS_Signal(Sema4Type *semaPt);
 // output: none
 void OS_bWait(Sema4Type *semaPt); 
 
+// ******** OS_bWaitTimeout ************
+// input:  pointer to a binary semaphore
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: 1 if successful, 0 if timed out
+int OS_bWaitTimeout(Sema4Type *semaPt, unsigned long timeout); 
+
 // ******** OS_bSignal ************ 
 // input:  pointer to a binary semaphore
 // output: none
 void OS_bSignal(Sema4Type *semaPt); 
 
+// event group, 32 flags that threads can wait on
+struct EventGroup{
+  volatile uint32_t Flags;  // one bit per event, 1 means set
+  struct tcb *BlockPt;      // threads waiting on this group, 0 if none
+};
+typedef struct EventGroup EventGroupType;
+
+#define OS_FLAG_ANY     0x00   // wait for any of the flags
+#define OS_FLAG_ALL     0x01   // wait for all of the flags
+#define OS_FLAG_CLEAR   0x02   // clear the matching flags when the wait ends
+
+// ******** OS_InitEventGroup ************
+// initialize event group, all flags clear
+// input:  pointer to an event group
+// output: none
+void OS_InitEventGroup(EventGroupType *groupPt);
+
+// ******** OS_FlagSet ************
+// set flags and wake the threads waiting for them
+// each flag is set with a single store to its bit-band alias
+// can be called from foreground threads and from ISRs
+// input:  pointer to an event group, must be in SRAM
+//         flags to set
+// output: none
+void OS_FlagSet(EventGroupType *groupPt, uint32_t mask);
+
+// ******** OS_FlagClear ************
+// clear flags, can be called from foreground threads and from ISRs
+// input:  pointer to an event group, must be in SRAM
+//         flags to clear
+// output: none
+void OS_FlagClear(EventGroupType *groupPt, uint32_t mask);
+
+// ******** OS_FlagWait ************
+// wait until any or all of the flags in mask are set
+// input:  pointer to an event group
+//         flags to wait for
+//         OS_FLAG_ANY or OS_FLAG_ALL, plus OS_FLAG_CLEAR to consume
+//         the matching flags
+//         timeout in ms, 0 does not block, OS_FOREVER never times out
+// output: flags that satisfied the wait, 0 if timed out
+uint32_t OS_FlagWait(EventGroupType *groupPt, uint32_t mask,
+   uint32_t options, unsigned long timeout);
+
 //******** OS_AddThread *************** 
 // add a foregound thread to the scheduler
 // Inputs: pointer to a void/void foreground task
 //         number of bytes allocated for its stack
-//         priority, 0 is highest, 5 is the lowest
+//         priority, 0 is highest, 6 is the lowest, the highest
+//         ready thread runs, equal priorities share by time slice,
+//         at OS_SHAREPRI by OS_TICKETS tickets each
 // Outputs: 1 if successful, 0 if this thread can not be added
 // stack size must be divisable by 8 (aligned to double word boundary)
 int OS_AddThread(void(*task)(void), 
    unsigned long stackSize, unsigned long priority);
 
+//******** OS_AddThreadArg *************** 
+// add a foregound thread that receives an argument, so one
+// function can be the body of many threads
+// Inputs: pointer to a void/void* foreground task
+//         argument passed to the task
+//         number of bytes allocated for its stack
+//         priority, 0 is highest, 6 is the lowest, the highest
+//         ready thread runs, equal priorities share by time slice
+// Outputs: 1 if successful, 0 if this thread can not be added
+// stack size must be divisable by 8 (aligned to double word boundary)
+int OS_AddThreadArg(void(*task)(void *), void *arg,
+   unsigned long stackSize, unsigned long priority);
+
+//******** OS_AddDeadlineThread *************** 
+// add a periodic thread with a deadline in every period, it is released
+// now and then every period ms, and calls OS_WaitNextPeriod at the end of each job
+// with OS_EDF the ready deadline threads all run at priority OS_EDFPRI,
+// earliest absolute deadline first, ahead of other threads at that level;
+// without it they run at the given fixed priority
+// Inputs: pointer to a void/void foreground task
+//         number of bytes allocated for its stack
+//         deadline, ms after each release, at most the period
+//         period, ms
+//         priority, used only without OS_EDF
+// Outputs: 1 if successful, 0 if this thread can not be added
+int OS_AddDeadlineThread(void(*task)(void), unsigned long stackSize,
+   unsigned long deadline, unsigned long period, unsigned long priority);
+
+//******** OS_WaitNextPeriod *************** 
+// end the current job of a deadline thread, counts a miss if it ended
+// after its deadline, and sleeps until the next release
+// a job that ended after the next release starts the next one at once
+// Inputs: none
+// Outputs: none
+void OS_WaitNextPeriod(void);
+
+//******** OS_AddShareThread *************** 
+// add a best-effort thread at priority OS_SHAREPRI, below the real-time
+// priorities, the ready threads there get CPU time in proportion to
+// their tickets instead of equal time slices
+// Inputs: pointer to a void/void foreground task
+//         number of bytes allocated for its stack
+//         tickets, 1 to OS_MAXTICKETS
+// Outputs: 1 if successful, 0 if this thread can not be added
+int OS_AddShareThread(void(*task)(void), unsigned long stackSize, unsigned long tickets);
+
+//******** OS_SetTickets *************** 
+// change the tickets of a thread at OS_SHAREPRI, while it runs
+// its new share starts with its next time slice
+// Inputs: thread id, as from OS_Id, tickets 1 to OS_MAXTICKETS
+// Outputs: 1 if successful, 0 if it is not a share thread
+int OS_SetTickets(unsigned long id, unsigned long tickets);
+
+//******** OS_SetThreshold *************** 
+// set the preemption threshold of the running thread, while it runs
+// only threads with a priority above the threshold can preempt it,
+// so threads between the two wait until it blocks, sleeps or yields
+// Inputs: threshold, 0 to the thread's priority, OS_NOTHRESHOLD turns it off
+// Outputs: none
+void OS_SetThreshold(unsigned long threshold);
+
+// statistics of one thread, from OS_ThreadStats
+struct threadstats{
+  unsigned long id;
+  unsigned long priority;
+  unsigned long threshold;
+  unsigned long state;      // 0 free, 1 ready, 2 blocked, 3 sleeping, 4 throttled
+  unsigned long Switches;   // times it was switched to
+  unsigned long CPU;        // ms run
+  unsigned long StackUsed;  // words, most ever used
+  unsigned long Jobs;       // periods completed by a deadline thread
+  unsigned long Misses;     // of those, completed after the deadline
+  unsigned long Tickets;    // CPU share at OS_SHAREPRI, 0 for other threads
+};
+typedef struct threadstats ThreadStatsType;
+
+//******** OS_ThreadStats *************** 
+// Inputs: tcb number, 0 to the number of tcbs - 1
+//         where to copy the statistics
+// Outputs: 1 if the tcb holds a thread, 0 if it is free,
+//          -1 if there is no such tcb
+int OS_ThreadStats(unsigned long id, ThreadStatsType *stats);
+
+//******** OS_StackNeeded *************** 
+// total stack the current threads have used, in words
+// Inputs: 0 for one stack per thread, as allocated now
+//         1 for the worst case if threads that can not preempt
+//         one another shared a stack
+// Outputs: words, ISR frames not included
+unsigned long OS_StackNeeded(int shared);
+
+// sporadic server, a CPU budget shared by aperiodic threads,
+// or a reservation, a budget every period for one thread
+#define OS_SERVERREPL 4           // chunks of use waiting to come back
+struct server{
+  char *name;
+  unsigned long Budget;     // 12.5ns units per period
+  unsigned long Period;     // ms
+  long Remaining;           // 12.5ns units left, below 0 after an overrun
+  unsigned long active;     // 1 while a chunk of use is running
+  unsigned long start;      // kernel ms when the chunk started
+  unsigned long used;       // 12.5ns units used in the chunk
+  unsigned long numRepl;    // replenishments waiting
+  unsigned long replTime[OS_SERVERREPL];   // kernel ms when it comes back
+  unsigned long replAmount[OS_SERVERREPL]; // 12.5ns units
+  struct tcb *ThrottlePt;   // threads waiting for budget
+  unsigned long Throttles;  // times a thread ran out of budget
+  unsigned long Used;       // 12.5ns units below 1ms of all use
+  unsigned long UsedMs;     // ms of all use
+  unsigned long Reservation; // 1 if the whole budget comes back each period
+  void (*OnThrottle)(unsigned long id); // called when a thread is throttled, or 0
+  struct server *next;      // next on the list of all servers
+};
+typedef struct server ServerType;
+
+//******** OS_InitServer *************** 
+// initialize a sporadic server, its threads can run at most
+// budget ms in any period ms, then wait for their budget to return
+// Inputs: server, name for reports, budget and period in ms
+// Outputs: none
+void OS_InitServer(ServerType *serverPt, char *name, unsigned long budget, unsigned long period);
+
+//******** OS_InitReservation *************** 
+// initialize a CPU reservation, its threads can run at most budget ms
+// in each period ms, then wait for the next period
+// Inputs: reservation, name for reports, budget and period in ms,
+//         function called with the thread id each time a thread is throttled,
+//         or 0; it runs in SysTick_Handler, so it must be short and not block
+// Outputs: none
+void OS_InitReservation(ServerType *serverPt, char *name, unsigned long budget,
+   unsigned long period, void(*onThrottle)(unsigned long id));
+
+//******** OS_ServerAttach *************** 
+// run a thread on a server's budget from now on
+// Inputs: thread id, as from OS_Id, server, or 0 to leave it
+// Outputs: 1 if successful, 0 if there is no such thread,
+//          or it is waiting for its budget
+int OS_ServerAttach(unsigned long id, ServerType *serverPt);
+
+//******** OS_ServerJoin *************** 
+// run the calling thread on a server's budget from now on
+// Inputs: server, or 0 to leave it
+// Outputs: none
+void OS_ServerJoin(ServerType *serverPt);
+
+//******** OS_ServerList *************** 
+// first server on the list, follow next for the others
+// Inputs: none
+// Outputs: pointer to the first server, null if none
+ServerType *OS_ServerList(void);
+
+//******** OS_ThreadPool_Init *************** 
+// create the worker threads that run jobs given to OS_ThreadPool_Submit
+// call once, before OS_Launch
+// Inputs: number of worker threads (at most 8)
+//         number of bytes allocated for each worker's stack
+//         priority of the workers, 0 is highest, 5 is the lowest
+// Outputs: number of workers created
+int OS_ThreadPool_Init(unsigned long numWorkers,
+   unsigned long stackSize, unsigned long priority);
+
+//******** OS_ThreadPool_Submit *************** 
+// queue a job for the next idle worker thread
+// can be called from foreground threads and from ISRs, never blocks
+// It is assumed that the job will run to completion and return
+// The job can block or sleep, but it can not kill
+// Inputs: pointer to a void/void* job
+//         argument passed to the job
+// Outputs: 1 if successful, 0 if the job queue is full
+int OS_ThreadPool_Submit(void(*task)(void *), void *arg);
+
+//******** Channels *************** 
+// Every kernel FIFO or queue is a channel: it has an overflow
+// policy and keeps statistics, and all channels are on one list
+#define OS_CHANNEL_REJECT  0   // a full channel refuses the new element
+#define OS_CHANNEL_DROPOLD 1   // a full channel discards its oldest element
+#define OS_CHANNEL_BLOCK   2   // a thread producer waits for room, up to Timeout ms
+                               // an ISR producer is refused instead
+#define OS_CHANNEL_LATEST  3   // one slot, every put overwrites it (mailbox)
+// results of OS_ChannelReserve
+#define OS_CHANNEL_FULL    0   // refused, the element is dropped
+#define OS_CHANNEL_ROOM    1   // room for one element is reserved
+#define OS_CHANNEL_REPLACE 2   // full, remove the oldest element and reserve again
+struct channel {
+  char *name;
+  unsigned long Policy;
+  unsigned long Timeout;       // ms, for OS_CHANNEL_BLOCK
+  unsigned long Capacity;      // most elements the channel can hold
+  Sema4Type Room;              // number of free elements
+  unsigned long Puts;          // elements accepted
+  unsigned long Gets;          // elements removed by the consumer
+  unsigned long Drops;         // elements refused or discarded
+  unsigned long HighWater;     // most elements held at one time
+  struct channel *next;        // next on the list of all channels
+};
+typedef struct channel ChannelType;
+
+//******** OS_ChannelInit *************** 
+// clear the statistics and put the channel on the list
+// call from the FIFO's own initialization
+// Inputs: channel, name for the report, capacity in elements,
+//         policy (OS_CHANNEL_REJECT ...), timeout in ms for OS_CHANNEL_BLOCK
+// Outputs: none
+void OS_ChannelInit(ChannelType *chPt, char *name, unsigned long capacity,
+   unsigned long policy, unsigned long timeout);
+
+//******** OS_ChannelPolicy *************** 
+// change what happens when the channel is full
+// Inputs: channel, policy, timeout in ms for OS_CHANNEL_BLOCK
+// Outputs: none
+void OS_ChannelPolicy(ChannelType *chPt, unsigned long policy, unsigned long timeout);
+
+//******** OS_ChannelReserve *************** 
+// producer side, called before putting one element
+// applies the policy when the channel is full, counts drops
+// Inputs: channel
+// Outputs: OS_CHANNEL_ROOM, OS_CHANNEL_FULL or OS_CHANNEL_REPLACE
+int OS_ChannelReserve(ChannelType *chPt);
+
+//******** OS_ChannelPut *************** 
+// producer side, called after an element was put
+// Inputs: channel, elements now in the channel
+// Outputs: none
+void OS_ChannelPut(ChannelType *chPt, unsigned long size);
+
+//******** OS_ChannelGet *************** 
+// consumer side, called after an element was removed, frees its room
+// Inputs: channel
+// Outputs: none
+void OS_ChannelGet(ChannelType *chPt);
+
+//******** OS_ChannelList *************** 
+// first channel on the list, follow next for the others
+// Inputs: none
+// Outputs: pointer to the first channel, null if none
+ChannelType *OS_ChannelList(void);
+
 //******** OS_Id *************** 
 // returns the thread ID for the currently running thread
 // Inputs: none
@@ -118,6 +464,98 @@ unsigned long OS_Id(void);
 int OS_AddPeriodicThread(void(*task)(void), 
    unsigned long period, unsigned long priority);
 
+//******** OS_AddPeriodicThreadWCET *************** 
+// add a background periodic task after a response time analysis
+// of every periodic load, with its deadline at the end of its period
+// Inputs: pointer to a void/void background function, name for reports
+//         period given in system time units (12.5ns)
+//         priority 0 is the highest, 5 is the lowest
+//         worst case execution time in 12.5ns units, or 0 to rely on
+//         the longest run measured, which OS_PeriodicCheck uses later
+// Outputs: 1 if added, 0 if a deadline could be missed or no timer is free
+int OS_AddPeriodicThreadWCET(void(*task)(void), char *name,
+   unsigned long period, unsigned long priority, unsigned long wcet);
+
+//******** OS_AddPeriodicLoad *************** 
+// declare a periodic ISR started elsewhere, so the analysis counts it
+// Inputs: name, period in 12.5ns units, NVIC priority 0 to 7,
+//         worst case execution time in 12.5ns units, or 0 if measured
+// Outputs: id for OS_PeriodicTime, -1 if a deadline could be missed
+int OS_AddPeriodicLoad(char *name, unsigned long period,
+   unsigned long priority, unsigned long wcet);
+
+//******** OS_PeriodicTime *************** 
+// record how long one run of a periodic load took
+// Inputs: id from OS_AddPeriodicLoad, run time in 12.5ns units
+// Outputs: none
+void OS_PeriodicTime(int id, unsigned long time);
+
+//******** OS_PeriodicCheck *************** 
+// repeat the response time analysis with the run times measured so far
+// Inputs: none
+// Outputs: 1 if every periodic load meets its deadline, 0 if not
+int OS_PeriodicCheck(void);
+
+// one periodic load in the analysis, times in 12.5ns units
+struct periodic{
+  void (*task)(void);       // run by a kernel timer, 0 for a declared load
+  char *name;
+  unsigned long period;     // also the deadline
+  unsigned long priority;   // NVIC priority
+  unsigned long wcet;       // estimate given, 0 if none
+  unsigned long MaxTime;    // longest run measured
+  unsigned long Runs;
+  unsigned long Response;   // worst case response time, last analysis
+};
+typedef struct periodic periodicType;
+
+//******** OS_PeriodicStats *************** 
+// Inputs: entry, 0 to the number of periodic loads - 1
+//         where to copy it, Response as of the last analysis
+// Outputs: 1 if copied, 0 if there is no such entry
+int OS_PeriodicStats(unsigned long i, periodicType *stats);
+
+//******** OS_PeriodicUtilization *************** 
+// Inputs: none
+// Outputs: CPU use of every periodic load in 0.1%, by the WCETs used
+//          in the analysis; rate monotonic priorities are guaranteed
+//          below n(2^(1/n)-1) for n loads, 1000, 828, 779, 756, 743,
+//          734, 728, 724, but response times are exact at any use
+unsigned long OS_PeriodicUtilization(void);
+
+// one entry of a cyclic executive's schedule table
+#define OS_MAXCYCLIC 16
+struct cyclicentry{
+  unsigned long offset;     // ms from the start of the major frame
+  void (*task)(void);       // runs to completion in Timer5A_Handler
+};
+typedef struct cyclicentry CyclicEntryType;
+
+// statistics of one entry, times in 12.5ns units
+struct cyclicstats{
+  unsigned long Runs;
+  unsigned long MaxTime;    // longest run measured
+  unsigned long Overruns;   // runs that ended after the next entry was due
+};
+typedef struct cyclicstats cyclicStatsType;
+
+//******** OS_CyclicStart *************** 
+// run a schedule table from Timer5A, the first frame starts 1 ms from now
+// call once, the table must stay in place, it is not copied
+// Inputs: table of entries, offsets in ms from the start of the frame,
+//         increasing, all below the frame length
+//         number of entries, 1 to OS_MAXCYCLIC
+//         frame, ms per major frame
+//         priority of Timer5A, 0 to 5, the tasks run at this NVIC priority
+// Outputs: 1 if started, 0 if the table is not valid
+int OS_CyclicStart(const CyclicEntryType *table, unsigned long num,
+   unsigned long frame, unsigned long priority);
+
+//******** OS_CyclicStats *************** 
+// Inputs: entry, 0 to the number of entries - 1, where to copy its statistics
+// Outputs: 1 if copied, 0 if there is no such entry
+int OS_CyclicStats(unsigned long i, cyclicStatsType *stats);
+
 //******** OS_AddSW1Task *************** 
 // add a background task to run whenever the BUTTON1 (PD6) button is pushed
 // Inputs: pointer to a void/void background function
@@ -140,6 +578,106 @@ int OS_AddSW1Task(void(*task)(void), unsigned long priority);
 // This task does not have a Thread ID
 int OS_AddSW2Task(void(*task)(void), unsigned long priority);
 
+//******** OS_AddRTCTask *************** 
+// add a run-to-completion task, all of them share one stack
+// it runs once for each OS_RTC_Activate, above every thread
+// and below the device interrupts
+// Inputs: pointer to a void/void task
+//         priority 0 is the highest, 3 is the lowest
+// Outputs: task id 0 to 15, or -1 if no room
+// The task can call OS_Signal, OS_bSignal, OS_RTC_Activate and
+// any put that does not block; it can not spin, wait, sleep, or kill
+int OS_AddRTCTask(void(*task)(void), unsigned long priority);
+
+//******** OS_RTC_Activate *************** 
+// request one run of a task, from a thread, ISR or another task
+// Inputs: task id from OS_AddRTCTask
+// Outputs: none
+void OS_RTC_Activate(int id);
+
+//******** OS_RTC_ActivateIn *************** 
+// request one run of a task after a delay, replaces a delay already running
+// Inputs: task id from OS_AddRTCTask, delay in ms (1 or more)
+// Outputs: none
+void OS_RTC_ActivateIn(int id, unsigned long ms);
+
+//******** OS_RTC_Lock *************** 
+// stack resource policy lock of a resource shared by RTC tasks
+// Inputs: ceiling, the highest priority (0 to 3) of the resource's users
+// Outputs: previous ceiling, to give to OS_RTC_Unlock
+unsigned long OS_RTC_Lock(unsigned long ceiling);
+
+//******** OS_RTC_Unlock *************** 
+// Inputs: value returned by the matching OS_RTC_Lock
+// Outputs: none
+void OS_RTC_Unlock(unsigned long previous);
+
+// coroutine, a task without a stack of its own
+// its function starts with OS_CO_BEGIN and ends with OS_CO_END,
+// and is called again from where it left off after each
+// OS_CO_YIELD, OS_CO_SLEEP or OS_CO_WAIT
+// local variables are lost at those points, keep state in
+// statics or behind co->arg; use at most one of them per line,
+// and never inside a switch statement of your own
+struct cotask{
+  struct wait wait;         // first, the kernel finds the coroutine from it
+  unsigned short lc;        // line to go on from, 0 at the start
+  unsigned char state;      // OS_CO_READY, WAITING, SLEEPING or DONE
+  unsigned long wake;       // OS_Co_Now when the sleep ends
+  int (*task)(struct cotask *co);
+  void *arg;
+  struct cotask *next;
+};
+typedef struct cotask CoType;
+
+#define OS_CO_READY     0
+#define OS_CO_WAITING   1
+#define OS_CO_SLEEPING  2
+#define OS_CO_DONE      3
+
+#define OS_CO_BEGIN(co)  switch((co)->lc){ case 0:
+#define OS_CO_END(co)    } (co)->lc = 0; return OS_CO_DONE
+
+// let the other coroutines run
+#define OS_CO_YIELD(co)  do{ (co)->lc = __LINE__; return OS_CO_READY; \
+  case __LINE__:; }while(0)
+
+// go on after ms milliseconds
+#define OS_CO_SLEEP(co,ms)  do{ (co)->wake = OS_Co_Now()+(ms); (co)->lc = __LINE__; \
+  return OS_CO_SLEEPING; case __LINE__:; }while(0)
+
+// take one unit of a counting or binary semaphore; while it is busy the
+// coroutine waits in the semaphore's FIFO like a thread, and the signal
+// that frees the unit hands it over and wakes the coroutine thread
+#define OS_CO_WAIT(co,s)  do{ if(OS_Co_Wait((co),(s)) == 0){ (co)->lc = __LINE__; \
+  return OS_CO_WAITING; case __LINE__:; } }while(0)
+
+//******** OS_Co_Init *************** 
+// create the thread that runs every coroutine
+// Inputs: stack size in words, for the deepest call made by any coroutine
+//         priority of the thread, 0 is the highest
+// Outputs: 1 if successful, 0 if the thread can not be added
+int OS_Co_Init(unsigned long stackSize, unsigned long priority);
+
+//******** OS_AddCoTask *************** 
+// add a coroutine, it starts at OS_CO_BEGIN the next time round
+// Inputs: coroutine, its function, argument it finds in co->arg
+// Outputs: none
+void OS_AddCoTask(CoType *co, int(*task)(CoType *co), void *arg);
+
+//******** OS_Co_Now *************** 
+// kernel time for OS_CO_SLEEP, unlike OS_MsTime it is never cleared
+// Inputs: none
+// Outputs: time in ms
+unsigned long OS_Co_Now(void);
+
+//******** OS_Co_Wait *************** 
+// take one unit of a semaphore for OS_CO_WAIT, or queue the
+// coroutine on it until a signal hands one over
+// Inputs: coroutine, pointer to a counting or binary semaphore
+// Outputs: 1 if taken, 0 if the coroutine waits
+int OS_Co_Wait(CoType *co, Sema4Type *semaPt);
+
 
 // ******** OS_Sleep ************
 // place this thread into a dormant state
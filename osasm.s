@@ -28,11 +28,28 @@
         REQUIRE8
         PRESERVE8
 
+; OS_RAMFUNC {TRUE} puts the hot paths in .ramfunc, set it with
+; --pd "OS_RAMFUNC SETL {TRUE}" to match #define OS_RAMFUNC 1 in os.h;
+; the word at the end of this file links only if the two agree
+        IF :LNOT::DEF:OS_RAMFUNC
+        GBLL    OS_RAMFUNC
+OS_RAMFUNC SETL {FALSE}          ; flash, like the os.h default
+        ENDIF
+
         EXTERN  RunPt            ; currently running thread
         EXPORT  OS_DisableInterrupts
         EXPORT  OS_EnableInterrupts
         EXPORT  StartOS
         EXPORT  SysTick_Handler
+        EXPORT  OS_TryDecrement
+        EXPORT  OS_TryIncrement
+        EXPORT  OS_TrySet
+        EXPORT  OS_RaiseBasePri
+        EXPORT  OS_SetBasePri
+        EXPORT  UART4_Handler    ; run-to-completion level 0
+        EXPORT  UART5_Handler    ; level 1
+        EXPORT  UART6_Handler    ; level 2
+        EXPORT  UART7_Handler    ; level 3
 
 
 OS_DisableInterrupts
@@ -44,7 +61,133 @@ OS_EnableInterrupts
         CPSIE   I
         BX      LR
 
+        IF OS_RAMFUNC            ; hot paths, ramfunc.sct puts them in SRAM
+        AREA |.ramfunc|, CODE, READONLY, ALIGN=2
+        THUMB
+        ENDIF
+
+;*********** OS_TryDecrement ***************
+; semaphore fast path, decrement Value if it is positive
+; LDREX/STREX retry if an interrupt touched Value in between
+; inputs:  R0 = pointer to semaphore, Value at offset 0
+; outputs: R0 = 1 if decremented, 0 if Value was not positive
+OS_TryDecrement
+    LDREX   R1, [R0]           ; R1 = Value, exclusive
+    CMP     R1, #0
+    BLE     TryFail            ; busy, caller has to block
+    SUBS    R1, R1, #1
+    STREX   R2, R1, [R0]       ; R2 = 0 if still exclusive
+    CMP     R2, #0
+    BNE     OS_TryDecrement    ; interrupted, try again
+    MOVS    R0, #1
+    BX      LR
+
+;*********** OS_TryIncrement ***************
+; semaphore fast path, increment Value if no thread is blocked
+; inputs:  R0 = pointer to semaphore, Value at offset 0, BlockPt at 4
+; outputs: R0 = 1 if incremented, 0 if a waiter has to be woken
+OS_TryIncrement
+    LDREX   R1, [R0]           ; R1 = Value, exclusive
+    LDR     R2, [R0, #4]       ; R2 = BlockPt
+    CBNZ    R2, TryFail        ; waiters, caller wakes one
+    ADDS    R1, R1, #1
+    STREX   R2, R1, [R0]       ; R2 = 0 if still exclusive
+    CMP     R2, #0
+    BNE     OS_TryIncrement    ; interrupted, try again
+    MOVS    R0, #1
+    BX      LR
+
+;*********** OS_TrySet ***************
+; binary semaphore fast path, set Value to 1 if no thread is blocked
+; inputs:  R0 = pointer to semaphore, Value at offset 0, BlockPt at 4
+; outputs: R0 = 1 if set, 0 if a waiter has to be woken
+OS_TrySet
+    LDREX   R1, [R0]           ; claim Value, exclusive
+    LDR     R2, [R0, #4]       ; R2 = BlockPt
+    CBNZ    R2, TryFail        ; waiters, caller wakes one
+    MOVS    R1, #1
+    STREX   R2, R1, [R0]       ; R2 = 0 if still exclusive
+    CMP     R2, #0
+    BNE     OS_TrySet          ; interrupted, try again
+    MOVS    R0, #1
+    BX      LR
+
+TryFail
+    CLREX                      ; drop the exclusive claim
+    MOVS    R0, #0
+    BX      LR
+
+        IF OS_RAMFUNC
+        LTORG                      ; literals next to the code that uses them
+        AREA |.text|, CODE, READONLY, ALIGN=2
+        THUMB
+        ENDIF
+
+;*********** OS_RaiseBasePri ***************
+; raise BASEPRI, never lowers it (BASEPRI_MAX)
+; inputs:  R0 = new BASEPRI, priority in bits 7:5
+; outputs: R0 = previous BASEPRI
+OS_RaiseBasePri
+    MRS     R1, BASEPRI
+    MSR     BASEPRI_MAX, R0
+    MOV     R0, R1
+    BX      LR
+
+;*********** OS_SetBasePri ***************
+; inputs:  R0 = BASEPRI from OS_RaiseBasePri
+OS_SetBasePri
+    MSR     BASEPRI, R0
+    BX      LR
+
+;*********** Run-to-completion tasks ***************
+; one software-triggered interrupt per level, all share RTCStack
+; the outermost entry moves SP from the interrupted thread to
+; RTCStack, nested entries stay on it, so a thread stack only
+; ever holds one exception frame for all the tasks
+    IMPORT  OS_RTC_Run
+    IMPORT  RTCNest
+    IMPORT  RTCStackTop
+UART4_Handler
+    MOVS    R0, #0
+    B       RTC_Entry
+UART5_Handler
+    MOVS    R0, #1
+    B       RTC_Entry
+UART6_Handler
+    MOVS    R0, #2
+    B       RTC_Entry
+UART7_Handler
+    MOVS    R0, #3
+RTC_Entry                      ; R0 = level
+    CPSID   I
+    LDR     R1, =RTCNest
+    LDR     R2, [R1]
+    ADDS    R3, R2, #1
+    STR     R3, [R1]           ; RTCNest++
+    MOV     R12, SP            ; R12 = interrupted SP
+    CBNZ    R2, RTCNested      ; already on the shared stack
+    LDR     R3, =RTCStackTop
+    LDR     SP, [R3]           ; SP = RTCStackTop
+RTCNested
+    PUSH    {R12,LR}           ; interrupted SP and EXC_RETURN
+    CPSIE   I
+    BL      OS_RTC_Run         ; every pending task of this level
+    CPSID   I
+    POP     {R12,LR}
+    LDR     R1, =RTCNest
+    LDR     R2, [R1]
+    SUBS    R2, R2, #1
+    STR     R2, [R1]           ; RTCNest--
+    MOV     SP, R12            ; back to the interrupted stack
+    CPSIE   I                  ; it was enabled, or we would not be here
+    BX      LR
+
     IMPORT  Scheduler
+        IF OS_RAMFUNC            ; hot paths, ramfunc.sct puts them in SRAM
+        AREA |.ramfunc|, CODE, READONLY, ALIGN=2
+        THUMB
+        ENDIF
+
 SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSID   I                  ; 2) Prevent interrupt during switch
     PUSH    {R4-R11}           ; 3) Save remaining regs r4-11
@@ -60,6 +203,12 @@ SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSIE   I                  ; 9) tasks run with interrupts enabled
     BX      LR                 ; 10) restore R0-R3,R12,LR,PC,PSR
 
+        IF OS_RAMFUNC
+        LTORG                      ; literals next to the code that uses them
+        AREA |.text|, CODE, READONLY, ALIGN=2
+        THUMB
+        ENDIF
+
 StartOS
     LDR     R0, =RunPt         ; currently running thread
     LDR     R2, [R0]           ; R2 = value of RunPt
@@ -73,5 +222,16 @@ StartOS
     CPSIE   I                  ; Enable interrupts at processor level
     BX      LR                 ; start first thread
 
+; os.c defines OS_RamfuncOn or OS_RamfuncOff from os.h's OS_RAMFUNC,
+; so an assembler setting that differs is an undefined symbol at link
+    ALIGN
+        IF OS_RAMFUNC
+        IMPORT  OS_RamfuncOn
+    DCD     OS_RamfuncOn
+        ELSE
+        IMPORT  OS_RamfuncOff
+    DCD     OS_RamfuncOff
+        ENDIF
+
     ALIGN
     END
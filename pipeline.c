@@ -0,0 +1,207 @@
+// pipeline.c
+// Runs on LM4F120/TM4C123
+// Chains of processing stages connected by queues.
+// Queues copy elements of a fixed size and are channels,
+// so the overflow policy and the put/get/drop statistics
+// come from os.c.  Stage statistics are kept here.
+
+#include <stdint.h>
+#include <string.h>
+#include "os.h"
+#include "pipeline.h"
+
+long StartCritical (void);    // previous I bit, disable interrupts
+void EndCritical(long sr);    // restore I bit to previous value
+
+pipeStageType *PipeList;      // every stage
+
+//******** Pipe_InitQueue ***************
+// Inputs: queue, name for reports, storage of capacity*elemSize bytes
+//         (null for the input of a callback stage), element size in bytes,
+//         capacity in elements (a power of 2), overflow policy and timeout as in OS_ChannelInit
+// Outputs: none
+void Pipe_InitQueue(pipeQueueType *q, char *name, void *buf, unsigned long elemSize,
+   unsigned long capacity, unsigned long policy, unsigned long timeout){
+  q->buf = buf;
+  q->elemSize = elemSize;
+  q->capacity = capacity;
+  q->PutI = q->GetI = 0;
+  q->consumer = 0;
+  OS_InitSemaphore(&q->Available, 0);
+  OS_ChannelInit(&q->Channel, name, capacity, policy, timeout);
+}
+
+// remove the oldest element unread, for OS_CHANNEL_DROPOLD
+// returns PIPE_FAIL if the consumer already claimed every element
+int static discard(pipeQueueType *q){ long sr;
+  if(OS_WaitTimeout(&q->Available, 0) == 0){
+    return PIPE_FAIL;
+  }
+  sr = StartCritical();
+  q->GetI++;
+  EndCritical(sr);
+  OS_Signal(&q->Channel.Room);
+  return PIPE_SUCCESS;
+}
+
+// call work on the collected batch and pass the results on
+void static run(pipeStageType *s){
+  unsigned long i, n, start;
+  start = OS_Time();
+  n = (*s->work)(s->inBuf, s->count, s->outBuf);
+  s->BusyTime += OS_TimeDifference(start, OS_Time());
+  s->Batches++;
+  s->In += s->count;
+  s->count = 0;
+  if(s->out == 0){
+    return;                    // sink
+  }
+  start = OS_Time();
+  for(i = 0; i < n; i++){
+    if(Pipe_Put(s->out, &s->outBuf[i*s->out->elemSize]) == PIPE_SUCCESS){
+      s->Out++;
+    }
+  }
+  if(s->mode == PIPE_THREAD){  // only a thread can wait for room
+    s->StallTime += OS_TimeDifference(start, OS_Time())/80;
+  }
+}
+
+// thread stage: wait for a full batch, then run it
+void static StageThread(void *arg){
+  pipeStageType *s = arg;
+  unsigned long start;
+  for(;;){
+    start = OS_Time();
+    while(s->count < s->batch){
+      OS_Wait(&s->in->Available);
+      Pipe_Take(s->in, &s->inBuf[s->count*s->in->elemSize]);
+      s->count++;
+    }
+    s->StallTime += OS_TimeDifference(start, OS_Time())/80;
+    run(s);
+  }
+}
+
+//******** Pipe_AddStage ***************
+// connect a stage between two queues and start it
+// a thread stage creates its thread, a callback stage takes over its input
+// call before OS_Launch
+// Inputs: stage, name, input queue, output queue (null for a sink),
+//         batch size 1 to PIPE_MAXBATCH, work function, PIPE_THREAD or PIPE_CALLBACK,
+//         stack size and priority of the thread (ignored for callbacks)
+// Outputs: 1 if successful, 0 if not
+int Pipe_AddStage(pipeStageType *s, char *name, pipeQueueType *in, pipeQueueType *out,
+   unsigned long batch, pipeWorkType work, unsigned long mode,
+   unsigned long stackSize, unsigned long priority){
+  if((batch == 0) || (batch > PIPE_MAXBATCH) || (in->elemSize > PIPE_MAXELEM) ||
+     (out && (out->elemSize > PIPE_MAXELEM)) || in->consumer){
+    return 0;
+  }
+  s->name = name;
+  s->in = in;
+  s->out = out;
+  s->batch = batch;
+  s->mode = mode;
+  s->work = work;
+  s->count = 0;
+  s->In = s->Out = s->Batches = s->BusyTime = s->StallTime = 0;
+  if(mode == PIPE_CALLBACK){
+    in->consumer = s;          // Pipe_Put runs the stage
+    in->Channel.Capacity = batch;
+  }
+  else if(OS_AddThreadArg(&StageThread, s, stackSize, priority) == 0){
+    return 0;
+  }
+  s->next = PipeList;
+  PipeList = s;
+  return 1;
+}
+
+//******** Pipe_Put ***************
+// add one element, from an ISR or a thread
+// a full queue is handled by its policy, a put to a callback
+// stage while its batch is running is dropped
+// Inputs: queue, pointer to the element
+// Outputs: PIPE_SUCCESS, or PIPE_FAIL if the element was dropped
+int Pipe_Put(pipeQueueType *q, const void *data){ long sr;
+  int room, full;
+  pipeStageType *s = q->consumer;
+  if(s){                       // callback stage, collect and run in place
+    sr = StartCritical();      // an ISR may put while a thread is putting
+    if(s->count >= s->batch){  // the full batch is still running
+      q->Channel.Drops++;
+      EndCritical(sr);
+      return PIPE_FAIL;
+    }
+    memcpy(&s->inBuf[s->count*q->elemSize], data, q->elemSize);
+    s->count++;
+    OS_ChannelPut(&q->Channel, s->count);
+    full = (s->count == s->batch);
+    EndCritical(sr);
+    if(full){                  // only this put filled it, run clears count
+      q->Channel.Gets += s->batch;
+      run(s);
+    }
+    return PIPE_SUCCESS;
+  }
+  while((room = OS_ChannelReserve(&q->Channel)) == OS_CHANNEL_REPLACE){
+    if(discard(q) == PIPE_FAIL){
+      room = OS_CHANNEL_FULL;  // drop the new element instead
+      break;
+    }
+  }
+  if(room == OS_CHANNEL_FULL){
+    return PIPE_FAIL;
+  }
+  sr = StartCritical();
+  memcpy(&q->buf[(q->PutI&(q->capacity-1))*q->elemSize], data, q->elemSize);
+  q->PutI++;
+  OS_ChannelPut(&q->Channel, q->PutI-q->GetI);
+  EndCritical(sr);
+  OS_Signal(&q->Available);
+  return PIPE_SUCCESS;
+}
+
+//******** Pipe_Get ***************
+// remove the oldest element, waiting at most timeout ms
+// Inputs: queue, where to copy the element, timeout (OS_FOREVER to wait)
+// Outputs: PIPE_SUCCESS, or PIPE_FAIL if nothing arrived in time
+int Pipe_Get(pipeQueueType *q, void *data, unsigned long timeout){
+  if(OS_WaitTimeout(&q->Available, timeout) == 0){
+    return PIPE_FAIL;
+  }
+  return Pipe_Take(q, data);
+}
+
+//******** Pipe_Take ***************
+// remove the oldest element without waiting,
+// after OS_WaitAny has taken q->Available
+// Inputs: queue, where to copy the element
+// Outputs: PIPE_SUCCESS
+int Pipe_Take(pipeQueueType *q, void *data){ long sr;
+  sr = StartCritical();        // a drop-oldest put may move GetI too
+  memcpy(data, &q->buf[(q->GetI&(q->capacity-1))*q->elemSize], q->elemSize);
+  q->GetI++;
+  EndCritical(sr);
+  OS_ChannelGet(&q->Channel);
+  return PIPE_SUCCESS;
+}
+
+//******** Pipe_Size ***************
+// Inputs: queue
+// Outputs: number of elements waiting
+unsigned long Pipe_Size(pipeQueueType *q){
+  if(q->consumer){
+    return q->consumer->count;
+  }
+  return q->PutI - q->GetI;
+}
+
+//******** Pipe_List ***************
+// first stage on the list, follow next for the others
+// Inputs: none
+// Outputs: pointer to the first stage, null if none
+pipeStageType *Pipe_List(void){
+  return PipeList;
+}
@@ -0,0 +1,113 @@
+// pipeline.h
+// Runs on LM4F120/TM4C123
+// Chains of processing stages connected by queues, so a
+// producer -> filter -> consumer chain is configuration.
+// A queue is a channel (os.h), so it has an overflow policy
+// and statistics.  A stage takes batch elements from its input
+// queue, calls its work function once, and puts the results on
+// its output queue.  A stage runs either as its own thread, or
+// to completion inside Pipe_Put, in whatever context put the
+// last element of the batch (ISR or thread).
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <stdint.h>
+#include "os.h"
+
+#define PIPE_THREAD   0     // stage is a thread blocked on its input queue
+#define PIPE_CALLBACK 1     // stage runs inside Pipe_Put, must not block
+#define PIPE_MAXBATCH 8     // most elements per batch
+#define PIPE_MAXELEM  16    // most bytes per element
+#define PIPE_SUCCESS  1
+#define PIPE_FAIL     0
+
+struct pipestage;
+struct pipequeue {
+  ChannelType Channel;      // policy, put/get/drop counts, high water
+  Sema4Type Available;      // elements ready to take
+  uint8_t *buf;             // capacity elements of elemSize bytes
+  unsigned long elemSize;
+  unsigned long capacity;
+  unsigned long volatile PutI; // put next, counts up
+  unsigned long volatile GetI; // get next, counts up
+  struct pipestage *consumer;  // callback stage fed directly, or null
+};
+typedef struct pipequeue pipeQueueType;
+
+// work function, n inputs at in, writes its outputs to out
+// returns the number of outputs, 0 to PIPE_MAXBATCH
+typedef unsigned long (*pipeWorkType)(const void *in, unsigned long n, void *out);
+
+struct pipestage {
+  char *name;
+  pipeQueueType *in;        // input queue
+  pipeQueueType *out;       // output queue, null for a sink
+  unsigned long batch;      // inputs per call of work
+  unsigned long mode;       // PIPE_THREAD or PIPE_CALLBACK
+  pipeWorkType work;
+  unsigned long count;      // inputs collected so far
+  uint8_t inBuf[PIPE_MAXBATCH*PIPE_MAXELEM];
+  uint8_t outBuf[PIPE_MAXBATCH*PIPE_MAXELEM];
+  unsigned long In;         // elements consumed
+  unsigned long Out;        // elements produced
+  unsigned long Batches;    // calls of work
+  unsigned long BusyTime;   // time in work, 12.5ns units
+  unsigned long StallTime;  // time waiting for input or output room, us
+  struct pipestage *next;   // next on the list of all stages
+};
+typedef struct pipestage pipeStageType;
+
+//******** Pipe_InitQueue ***************
+// Inputs: queue, name for reports, storage of capacity*elemSize bytes
+//         (null for the input of a callback stage), element size in bytes,
+//         capacity in elements (a power of 2), overflow policy and timeout as in OS_ChannelInit
+// Outputs: none
+void Pipe_InitQueue(pipeQueueType *q, char *name, void *buf, unsigned long elemSize,
+   unsigned long capacity, unsigned long policy, unsigned long timeout);
+
+//******** Pipe_AddStage ***************
+// connect a stage between two queues and start it
+// a thread stage creates its thread, a callback stage takes over its input
+// call before OS_Launch
+// Inputs: stage, name, input queue, output queue (null for a sink),
+//         batch size 1 to PIPE_MAXBATCH, work function, PIPE_THREAD or PIPE_CALLBACK,
+//         stack size and priority of the thread (ignored for callbacks)
+// Outputs: 1 if successful, 0 if not
+int Pipe_AddStage(pipeStageType *s, char *name, pipeQueueType *in, pipeQueueType *out,
+   unsigned long batch, pipeWorkType work, unsigned long mode,
+   unsigned long stackSize, unsigned long priority);
+
+//******** Pipe_Put ***************
+// add one element, from an ISR or a thread
+// a full queue is handled by its policy, a put to a callback
+// stage while its batch is running is dropped
+// Inputs: queue, pointer to the element
+// Outputs: PIPE_SUCCESS, or PIPE_FAIL if the element was dropped
+int Pipe_Put(pipeQueueType *q, const void *data);
+
+//******** Pipe_Get ***************
+// remove the oldest element, waiting at most timeout ms
+// Inputs: queue, where to copy the element, timeout (OS_FOREVER to wait)
+// Outputs: PIPE_SUCCESS, or PIPE_FAIL if nothing arrived in time
+int Pipe_Get(pipeQueueType *q, void *data, unsigned long timeout);
+
+//******** Pipe_Take ***************
+// remove the oldest element without waiting,
+// after OS_WaitAny has taken q->Available
+// Inputs: queue, where to copy the element
+// Outputs: PIPE_SUCCESS
+int Pipe_Take(pipeQueueType *q, void *data);
+
+//******** Pipe_Size ***************
+// Inputs: queue
+// Outputs: number of elements waiting
+unsigned long Pipe_Size(pipeQueueType *q);
+
+//******** Pipe_List ***************
+// first stage on the list, follow next for the others
+// Inputs: none
+// Outputs: pointer to the first stage, null if none
+pipeStageType *Pipe_List(void);
+
+#endif
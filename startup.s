@@ -271,7 +271,8 @@ Reset_Handler
         ;
         ; Call the C library enty point that handles startup.  This will copy
         ; the .data section initializers from flash to SRAM and zero fill the
-        ; .bss section.
+        ; .bss section.  Linked with ramfunc.sct, it also copies the .ramfunc
+        ; kernel code to SRAM, before anything there is called.
         ;
         IMPORT  __main
         B       __main